@@ -0,0 +1,244 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// A sink that any number of threads may write to, whose output is written to
+// a stream or another sink by a background thread (C++11).
+//
+// Usage:
+//      std::ofstream file("app.log");
+//      PrintfAsyncSink<char> log(file);               // 1 MB buffers, 100 ms
+//      oprintf(log, "%s: %d\n", what, n);              // from any thread
+//
+//      PrintfAsyncSink<char> trace(fdSink, 64 * 1024, 20, 4);
+//
+// Output goes into the active one of several buffers (two by default).  When
+// it holds 'bufferSize' characters, or 'flushInterval' milliseconds after the
+// first of them went in, whichever comes first, it is handed to the flusher
+// thread and the next buffer becomes the active one.  The flusher writes the
+// full buffers to the target in the order they were filled.  Formatting
+// threads wait only for each other, and for the disk only if every buffer
+// is still waiting to be written.
+//
+// Each oprintf() call is a record, and records from different threads never
+// mix: a thread holds the sink from its first write in a record until the
+// Printf calls EndRecord().  So write to it only through oprintf() and the
+// like (including LOGPRINTF), or call EndRecord() after writing to it
+// directly.
+//
+// Flush() writes everything so far to the target and waits for it; the
+// destructor does the same.
+
+#ifndef ASYNCPRINTF_H
+#define ASYNCPRINTF_H
+
+#include "streamprintf.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+class PrintfAsyncSink: public PrintfSink<CharT>
+{
+public:
+	enum { DefaultBufferSize = 1024 * 1024, DefaultFlushInterval = 100, DefaultNumBuffers = 2 };
+
+	explicit PrintfAsyncSink(PrintfSink<CharT>& target, size_t bufferSize = DefaultBufferSize,
+							 int flushInterval = DefaultFlushInterval, int numBuffers = DefaultNumBuffers)
+		: _target(target), _owner(std::thread::id())
+		{ Init(bufferSize, flushInterval, numBuffers); }
+	explicit PrintfAsyncSink(std::basic_ostream<CharT>& ostm, size_t bufferSize = DefaultBufferSize,
+							 int flushInterval = DefaultFlushInterval, int numBuffers = DefaultNumBuffers)
+		: _ostmSink(&ostm), _target(_ostmSink), _owner(std::thread::id())
+		{ Init(bufferSize, flushInterval, numBuffers); }
+
+	virtual ~PrintfAsyncSink()
+	{
+		Flush();
+		{
+			std::lock_guard<std::mutex> lock(_queueMutex);
+			_stop = true;
+		}
+		_bufferFull.notify_one();
+		_flusher.join();
+
+		for (int i = 0; i < _numBuffers; ++i)
+			delete[] _buffers[i];
+		delete[] _buffers;
+		delete[] _lens;
+		delete[] _queue;
+	}
+
+	virtual void Write(const CharT* s, size_t len)
+	{
+		Lock();
+		while (len > 0)
+		{
+			size_t& used = _lens[_active];
+			if (used == 0)
+				_activeSince = std::chrono::steady_clock::now();
+
+			size_t n = (len < _bufferSize - used) ? len : _bufferSize - used;
+			memcpy(_buffers[_active] + used, s, n * sizeof(CharT));
+			used += n;
+			s += n;
+			len -= n;
+			if (used == _bufferSize)
+				Swap();
+		}
+	}
+
+	// Lets other threads write again.
+	virtual void EndRecord()
+	{
+		if (_owner.load(std::memory_order_relaxed) == std::this_thread::get_id())
+		{
+			_owner.store(std::thread::id(), std::memory_order_relaxed);
+			_mutex.unlock();
+		}
+	}
+
+	// Writes everything written so far to the target, and waits for it.
+	// Don't call it in the middle of a record.
+	void Flush()
+	{
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			if (_lens[_active] > 0)
+				Swap();
+		}
+
+		std::unique_lock<std::mutex> lock(_queueMutex);
+		while (_numQueued > 0 || _writing)
+			_bufferFree.wait(lock);
+	}
+
+private:
+	PrintfAsyncSink(const PrintfAsyncSink&);
+	PrintfAsyncSink& operator=(const PrintfAsyncSink&);
+
+	void Init(size_t bufferSize, int flushInterval, int numBuffers)
+	{
+		assertmsg(numBuffers >= 2, "printf: An async sink needs at least two buffers");
+		_bufferSize = bufferSize;
+		_flushInterval = std::chrono::milliseconds(flushInterval);
+		_numBuffers = numBuffers;
+		_buffers = new CharT*[numBuffers];
+		_lens = new size_t[numBuffers];
+		for (int i = 0; i < numBuffers; ++i)
+		{
+			_buffers[i] = new CharT[bufferSize];
+			_lens[i] = 0;
+		}
+		_active = 0;
+		_queue = new int[numBuffers];
+		_firstQueued = 0;
+		_numQueued = 0;
+		_writing = false;
+		_stop = false;
+		_flusher = std::thread(&PrintfAsyncSink::FlusherLoop, this);
+	}
+
+	// Takes the sink for this thread's record, unless it has it already.
+	void Lock()
+	{
+		if (_owner.load(std::memory_order_relaxed) != std::this_thread::get_id())
+		{
+			_mutex.lock();
+			_owner.store(std::this_thread::get_id(), std::memory_order_relaxed);
+		}
+	}
+
+	// Queues the active buffer for the flusher, and makes the next one
+	// active, waiting for the flusher to finish with it if need be.  Called
+	// with _mutex locked.
+	void Swap()
+	{
+		std::unique_lock<std::mutex> lock(_queueMutex);
+		Queue();
+		while (_lens[_active] != 0)
+			_bufferFree.wait(lock);
+	}
+
+	// Queues the active buffer and makes the next one active, whether or not
+	// the flusher is done with it.  Called with _mutex and _queueMutex locked.
+	void Queue()
+	{
+		_queue[(_firstQueued + _numQueued++) % _numBuffers] = _active;
+		_bufferFull.notify_one();
+		_active = (_active + 1) % _numBuffers;
+	}
+
+	void FlusherLoop()
+	{
+		std::unique_lock<std::mutex> lock(_queueMutex);
+		for (;;)
+		{
+			if (_numQueued == 0)
+			{
+				if (_stop)
+					return;
+				if (_bufferFull.wait_for(lock, _flushInterval) == std::cv_status::timeout
+					&& _mutex.try_lock())
+				{
+					// The active buffer is written if it has waited long
+					// enough, unless someone is in the middle of a record, or
+					// the next buffer is still queued: only this thread frees
+					// buffers, so it must never wait for one.  (try_lock()
+					// doesn't wait either, so taking _mutex while holding
+					// _queueMutex can't deadlock.)
+					if (_lens[_active] > 0 && std::chrono::steady_clock::now() - _activeSince >= _flushInterval
+						&& _lens[(_active + 1) % _numBuffers] == 0)
+						Queue();
+					_mutex.unlock();
+				}
+				continue;
+			}
+
+			int index = _queue[_firstQueued];
+			_firstQueued = (_firstQueued + 1) % _numBuffers;
+			--_numQueued;
+			_writing = true;
+			lock.unlock();
+
+			// a target that collects a record until its end (such as a
+			// PrintfWritevSink) is told to write it out
+			_target.Write(_buffers[index], _lens[index]);
+			_target.EndRecord();
+
+			lock.lock();
+			_lens[index] = 0;
+			_writing = false;
+			_bufferFree.notify_all();
+		}
+	}
+
+	PrintfOstreamSink<CharT> _ostmSink;	// used when we're writing to an ostream
+	PrintfSink<CharT>& _target;
+
+	CharT** _buffers;
+	size_t* _lens;			// how much of each buffer is filled
+	size_t _bufferSize;
+	int _numBuffers;
+	int _active;			// the buffer being filled
+	std::chrono::steady_clock::time_point _activeSince;
+	std::chrono::milliseconds _flushInterval;
+
+	std::mutex _mutex;		// held by the thread writing a record
+	std::atomic<std::thread::id> _owner;
+
+	// the full buffers, in the order they are to be written
+	std::mutex _queueMutex;
+	int* _queue;
+	int _firstQueued;
+	int _numQueued;
+	bool _writing;
+	bool _stop;
+	std::condition_variable _bufferFull;
+	std::condition_variable _bufferFree;
+	std::thread _flusher;
+};
+
+#endif // ASYNCPRINTF_H
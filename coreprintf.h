@@ -0,0 +1,661 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// The part of streamprintf.h that code calling oprintf() and strprintf()
+// needs: the sinks, the declaration of Printf, and the front ends.  It
+// includes neither <iostream> nor <sstream>, and defines none of Printf's
+// members, so it is cheap to include everywhere.
+//
+// Usage:
+//      // in a program linked with the streamprintf library
+//      #include "coreprintf.h"
+//      oprintf(std::cout, "%s %d\n", "hello", 3);
+//      std::string s = strprintf("%d items", n);
+//
+// The library (see CMakeLists.txt) compiles Printf<char> and Printf<wchar_t>
+// once, in streamprintf.cpp.  Its users are built with STREAMPRINTF_LIBRARY
+// defined, which keeps streamprintf.h from compiling them again wherever it
+// is included.  Other character types, and everything else
+// (PrintfBufferedSink, oprintf_array(), lazyprintf() and the rest), need
+// streamprintf.h.  Without the library, include streamprintf.h, which
+// includes this.
+
+#ifndef COREPRINTF_H
+#define COREPRINTF_H
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <string.h>
+#include <iosfwd>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define STREAMPRINTF_SSE2
+#endif
+
+// char16_t and char32_t (C++11), and char8_t (C++20)
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1900)
+	#define STREAMPRINTF_CHAR16
+#endif
+#ifdef __cpp_char8_t
+	#define STREAMPRINTF_CHAR8
+#endif
+
+#ifndef NDEBUG
+	#if _MSC_VER >= 1400
+		#define assertmsg(exp, msg) (void)( (exp) || (_wassert(_CRT_WIDE(msg), _CRT_WIDE(__FILE__), __LINE__), 0) )
+	#elif defined(_MSC_VER)
+		#define assertmsg(exp, msg) (void)( (exp) || (_assert(msg, __FILE__, __LINE__), 0) )
+	#else
+		#define assertmsg(exp, msg) (void)( (exp) || (__assert(msg, __FILE__, __LINE__), 0) )
+	#endif
+#else
+	#define assertmsg(exp, msg) assert(exp)
+#endif
+
+//-----------------------------------------------------------------------------
+// A PrintfSink is where Printf sends its output.  Static text from the format
+// string arrives through Write(), and the converted text of each argument
+// through WriteArg(), so that a sink can treat the two differently (the CSV
+// writer quotes arguments, for example).  Printf can write to an ostream or to
+// any PrintfSink.
+//
+// Text that stays where it is until the Printf is destroyed, namely the
+// static text of the format and strings that are written unchanged, arrives
+// through WriteInPlace() and WriteArgInPlace() instead, so that a sink may
+// keep the pointer rather than copy the text, as long as it is done with it
+// by EndRecord(), which the Printf's destructor calls.  With oprintf() and
+// the like, whose arguments outlive the Printf they create, that is always
+// so; a sink that relies on it must not be given to a Printf that is fed
+// temporaries one statement at a time.
+//
+// Padding and zero fill, which may be as wide as the field width says,
+// arrive through WriteFill() as a character and a count.  Unless a sink
+// overrides it, that is written through WriteArg() a chunk at a time.
+
+template <class CharT>
+class PrintfSink
+{
+public:
+	virtual ~PrintfSink() {}
+	virtual void Write(const CharT* s, size_t len) = 0;
+	virtual void WriteArg(const CharT* s, size_t len) { Write(s, len); }
+	virtual void WriteInPlace(const CharT* s, size_t len) { Write(s, len); }
+	virtual void WriteArgInPlace(const CharT* s, size_t len) { WriteArg(s, len); }
+	virtual void WriteFill(CharT c, size_t n);
+	virtual void EndRecord() {}
+};
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+class PrintfOstreamSink: public PrintfSink<CharT>
+{
+public:
+	PrintfOstreamSink(std::basic_ostream<CharT>* ostm = 0) : _ostm(ostm) {}
+	virtual void Write(const CharT* s, size_t len);
+
+protected:
+	std::basic_ostream<CharT>* _ostm;
+};
+
+//-----------------------------------------------------------------------------
+// Appends the output to a std::basic_string.
+
+template <class CharT>
+class PrintfStringSink: public PrintfSink<CharT>
+{
+public:
+	PrintfStringSink(std::basic_string<CharT>& s) : _s(s) {}
+	virtual void Write(const CharT* s, size_t len) { _s.append(s, len); }
+
+private:
+	std::basic_string<CharT>& _s;
+};
+
+//-----------------------------------------------------------------------------
+// Sets p[0..n) to c.  This is memset() for char; for wider characters, with
+// SSE2, 16 bytes are stored at a time.
+
+template <class CharT>
+inline void PrintfFill(CharT* p, CharT c, size_t n)
+{
+	size_t i = 0;
+#ifdef STREAMPRINTF_SSE2
+	if (sizeof(CharT) == 2 || sizeof(CharT) == 4)
+	{
+		const size_t perStore = 16 / sizeof(CharT);
+		__m128i v = (sizeof(CharT) == 2) ? _mm_set1_epi16((short) c) : _mm_set1_epi32((int) c);
+		for (; i + perStore <= n; i += perStore)
+			_mm_storeu_si128((__m128i*) (p + i), v);
+	}
+#endif
+	for (; i < n; ++i)
+		p[i] = c;
+}
+
+template <>
+inline void PrintfFill(char* p, char c, size_t n)
+{
+	memset(p, c, n);
+}
+
+//-----------------------------------------------------------------------------
+// Writes n copies of c to the sink, as part of an argument's text.  However
+// wide the field, only one chunk of PrintfFillChunk characters is filled, and
+// it is written as many times as needed.
+
+enum { PrintfFillChunk = 256 };
+
+template <class CharT>
+void PrintfSink<CharT>::WriteFill(CharT c, size_t n)
+{
+	CharT chunk[PrintfFillChunk];
+	PrintfFill(chunk, c, (n < (size_t) PrintfFillChunk) ? n : (size_t) PrintfFillChunk);
+	for (; n > (size_t) PrintfFillChunk; n -= PrintfFillChunk)
+		WriteArg(chunk, PrintfFillChunk);
+	if (n > 0)
+		WriteArg(chunk, n);
+}
+
+template <class CharT>
+inline void PrintfWriteFill(PrintfSink<CharT>& sink, CharT c, size_t n)
+{
+	sink.WriteFill(c, n);
+}
+
+//-----------------------------------------------------------------------------
+// The flags of a format specification.
+
+struct PrintfFlags
+{
+	enum Flag { LeftJustify=1, ForceSign=2, SpaceSign=4, Alternate=8, ZeroPad=16, Grouping=32 };
+};
+
+//-----------------------------------------------------------------------------
+// A parsed format specification, as passed to printf_formatter<T>::format().
+
+template <class CharT>
+struct PrintfSpec: public PrintfFlags
+{
+	int flags;				// Flag bits
+	int width;				// 0 if none
+	int precision;			// -1 if none
+	CharT conversion;		// e.g. 's' for "%-10s"
+
+	// Writes s[0..len) to the sink the way "%s" would: cut off at the
+	// precision, and padded with spaces to the width.
+	void WriteJustified(PrintfSink<CharT>& sink, const CharT* s, size_t len) const
+	{
+		if (precision >= 0 && len > (size_t) precision)
+			len = precision;
+		size_t pad = ((size_t) width > len) ? width - len : 0;
+
+		if (!(flags & LeftJustify))
+			WritePadding(sink, pad);
+		sink.WriteArg(s, len);
+		if (flags & LeftJustify)
+			WritePadding(sink, pad);
+	}
+
+	static void WritePadding(PrintfSink<CharT>& sink, size_t n)
+		{ PrintfWriteFill(sink, (CharT) ' ', n); }
+};
+
+//-----------------------------------------------------------------------------
+// printf_formatter<T> lets a type of your own be passed to Printf, oprintf()
+// and strprintf() and written straight to the output, with no temporary
+// string.  Specialize it like this:
+//
+//      template <>
+//      struct printf_formatter<Uuid>
+//      {
+//          // the conversion characters that a Uuid may be written with
+//          static const char* conversions() { return "sX"; }
+//
+//          template <class CharT>
+//          static void format(PrintfSink<CharT>& sink, const PrintfSpec<CharT>& spec, const Uuid& u)
+//          {
+//              CharT buf[36];
+//              ...
+//              spec.WriteJustified(sink, buf, 36);
+//          }
+//      };
+//
+//      oprintf(std::cout, "request %s\n", id);
+//
+// A type that hasn't specialized printf_formatter is handled as before.
+
+template <class T>
+struct printf_formatter
+{
+};
+
+template <class T>
+class printf_has_formatter
+{
+	typedef char yes[1];
+	typedef char no[2];
+	template <class U, U> struct Check;
+	template <class U> static yes& Test(Check<const char* (*)(), &printf_formatter<U>::conversions>*);
+	template <class U> static no& Test(...);
+
+public:
+	enum { value = sizeof(Test<T>(0)) == sizeof(yes) };
+};
+
+template <bool Condition, class T>
+struct PrintfEnableIf
+{
+	typedef T type;
+};
+
+template <class T>
+struct PrintfEnableIf<false, T>
+{
+};
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+class Printf: protected PrintfFlags
+{
+	#ifdef _MSC_VER
+	typedef __int64 INT64;
+	typedef unsigned __int64 UINT64;
+	#else
+	typedef long long INT64;
+	typedef unsigned long long UINT64;
+	#endif
+
+public:
+	Printf(std::basic_ostream<CharT>& ostm, const CharT* fmt)
+		: _fmt(fmt), _pos(0), _numPositional(0), _numCaptured(0), _deferred(false), _numStars(0), _ostmSink(&ostm), _sink(_ostmSink)
+		{ OutputStaticText(); ScanPositional(); }
+	Printf(PrintfSink<CharT>& sink, const CharT* fmt)
+		: _fmt(fmt), _pos(0), _numPositional(0), _numCaptured(0), _deferred(false), _numStars(0), _sink(sink)
+		{ OutputStaticText(); ScanPositional(); }
+	~Printf()
+	{
+		assertmsg( _fmt[_pos] == '\0', "printf: Too few arguments" );
+		_sink.EndRecord();
+	}
+
+	Printf& operator<<(bool n)                 { return Put(None | Int, (int) n); }
+	Printf& operator<<(short n)                { return Put(Short| Int, (int) n); }
+	Printf& operator<<(int n)                  { return Put(None | Int, n); }
+	Printf& operator<<(long n)                 { return Put(Long | Int, n); }
+	Printf& operator<<(INT64 n)                { return Put(Int64| Int, n); }
+
+	Printf& operator<<(unsigned short u)       { return Put(Short| Unsigned, (int) u); }
+	Printf& operator<<(unsigned int u)         { return Put(None | Unsigned, u); }
+	Printf& operator<<(unsigned long u)        { return Put(Long | Unsigned, u); }
+	Printf& operator<<(UINT64 u)               { return Put(Int64| Unsigned, u); }
+
+	Printf& operator<<(float f)                { return Put(None | Float, (double) f); }
+	Printf& operator<<(double f)               { return Put(None | Float, f); }
+	Printf& operator<<(long double f)          { return Put(Long | Float, f); }
+
+	Printf& operator<<(char c)                 { return Put(Short| Char, (int) c); }
+	Printf& operator<<(unsigned char c)        { return Put(Short| Char, (int) c); }
+#if !defined(_MSC_VER) || defined(_NATIVE_WCHAR_T_DEFINED)
+	Printf& operator<<(wchar_t c)              { return Put(Long | Char, (int) c); }
+#endif
+
+	Printf& operator<<(const char* s)          { return Put(Short| String, (const void*) s); }
+	Printf& operator<<(const unsigned char* s) { return Put(Short| String, (const void*) s); }
+	Printf& operator<<(const std::string& s)   { return Put(Short| String, (const void*) s.c_str()); }
+
+	Printf& operator<<(const wchar_t* w)       { return Put(Long | String, (const void*) w); }
+	Printf& operator<<(const std::wstring& w)  { return Put(Long | String, (const void*) w.c_str()); }
+
+#ifdef STREAMPRINTF_CHAR16
+	Printf& operator<<(char16_t c)             { return Put(Utf16| Char, (int) c); }
+	Printf& operator<<(char32_t c)             { return Put(Utf32| Char, (int) c); }
+	Printf& operator<<(const char16_t* s)      { return Put(Utf16| String, (const void*) s); }
+	Printf& operator<<(const char32_t* s)      { return Put(Utf32| String, (const void*) s); }
+	Printf& operator<<(const std::u16string& s) { return Put(Utf16| String, (const void*) s.c_str()); }
+	Printf& operator<<(const std::u32string& s) { return Put(Utf32| String, (const void*) s.c_str()); }
+#endif
+#ifdef STREAMPRINTF_CHAR8
+	Printf& operator<<(char8_t c)              { return Put(Utf8 | Char, (int) c); }
+	Printf& operator<<(const char8_t* s)       { return Put(Utf8 | String, (const void*) s); }
+	Printf& operator<<(const std::u8string& s) { return Put(Utf8 | String, (const void*) s.c_str()); }
+#endif
+
+	Printf& operator<<(const void* v)          { return Put(None | Pointer, v); }
+
+	template <class T>
+	typename PrintfEnableIf<printf_has_formatter<T>::value, Printf&>::type operator<<(const T& t)
+	{
+		UserArg arg = { &t, &printf_formatter<T>::conversions, &FormatUser<T> };
+		return Put(None | User, arg);
+	}
+
+	// The "'" flag ("%'d", "%'.2f") puts this between groups of three digits.
+	// It is "," unless changed, and doesn't depend on the locale.  It is
+	// shared by all threads, so set it once at startup.  Only the first
+	// MaxGroupSeparator characters are kept.
+	enum { MaxGroupSeparator = 7 };
+	static const CharT* GroupSeparator()       { return GroupSeparatorBuffer(); }
+	static void SetGroupSeparator(const CharT* sep)
+	{
+		CharT* buf = GroupSeparatorBuffer();
+		size_t i = 0;
+		for (; sep[i] != '\0' && i < MaxGroupSeparator; ++i)
+			buf[i] = sep[i];
+		buf[i] = '\0';
+	}
+
+protected:
+	// for Char and String, Short is char, Long is wchar_t, and UtfN is charN_t
+	enum Size { None=1, Short=2, Long=3, Int64=4, Utf8=5, Utf16=6, Utf32=7, sizeMask=0xFF };
+	enum Type { Int=0x100, Unsigned=0x200, Float=0x300, Char=0x400, String=0x500,
+				WideString=0x600, Pointer=0x700, User=0x800, typeMask=0xFF00 };
+
+	// an argument whose type has a printf_formatter
+	struct UserArg
+	{
+		const void* object;
+		const char* (*conversions)();
+		void (*format)(PrintfSink<CharT>& sink, const PrintfSpec<CharT>& spec, const void* object);
+	};
+
+	template <class T>
+	static void FormatUser(PrintfSink<CharT>& sink, const PrintfSpec<CharT>& spec, const void* object)
+		{ printf_formatter<T>::format(sink, spec, *(const T*) object); }
+
+	// An argument captured for a format with positional specifications
+	// ("%2$s %1$d").  Strings are captured by pointer, not copied.
+	struct Arg
+	{
+		int sizeAndType;
+		union
+		{
+			int i;
+			long l;
+			INT64 ll;
+			unsigned u;
+			unsigned long ul;
+			UINT64 ull;
+			double d;
+			long double ld;
+			const void* p;
+			UserArg user;
+		};
+
+		void Set(int n)           { i = n; }
+		void Set(long n)          { l = n; }
+		void Set(INT64 n)         { ll = n; }
+		void Set(unsigned n)      { u = n; }
+		void Set(unsigned long n) { ul = n; }
+		void Set(UINT64 n)        { ull = n; }
+		void Set(double f)        { d = f; }
+		void Set(long double f)   { ld = f; }
+		void Set(const void* v)   { p = v; }
+		void Set(const UserArg& a) { user = a; }
+	};
+
+	enum { MaxPositional = 32 };
+
+	template <class T>
+	Printf& Put(int sizeAndType, T value)
+	{
+		if (_numPositional == 0 && !_deferred)
+			Do(sizeAndType, value);
+		else
+			Capture(sizeAndType, value);
+		return *this;
+	}
+
+	template <class T>
+	void Capture(int sizeAndType, T value)
+	{
+		assertmsg(_numCaptured < (_deferred ? (size_t) MaxPositional : _numPositional), "printf: Too many arguments");
+		if (_numCaptured >= MaxPositional)
+			return;
+		Arg& arg = _args[_numCaptured++];
+		arg.sizeAndType = sizeAndType;
+		arg.Set(value);
+		if (_numCaptured == _numPositional && !_deferred)
+			OutputPositional();
+	}
+
+	void Do(int sizeAndType, ...);
+	void DoArg(const Arg& arg);
+	static const char* FindChar(const char* set, CharT c)
+		{ return (c > 0 && c < 128) ? strchr(set, (char) c) : NULL; }	// c may be wide
+	static bool IsDigit(CharT c)
+		{ return c >= '0' && c <= '9'; }
+	static bool IntSizeMatches(Size size, CharT sizeChar);
+	static void FormatInteger(PrintfSink<CharT>& sink, UINT64 u, bool negative, CharT conv,
+							  int flags, int width, int precision);
+	static void FormatHexFloat(PrintfSink<CharT>& sink, bool finite, bool negative, unsigned lead, UINT64 frac,
+							   int fracBits, int exp, CharT conv, int flags, int width, int precision);
+	static void FormatFloat(PrintfSink<CharT>& sink, Size size, CharT conv,
+							int flags, int width, int precision, va_list vl);
+	template <class BodyT>
+	static void Justify(PrintfSink<CharT>& sink, const char* prefix, size_t prefixLen, size_t zeros,
+						const BodyT* body, size_t bodyLen, int flags, int width);
+	static void WriteBody(PrintfSink<CharT>& sink, const CharT* body, size_t len)
+		{ sink.WriteArg(body, len); }
+	template <class BodyT>
+	static void WriteBody(PrintfSink<CharT>& sink, const BodyT* body, size_t len);
+	static size_t Group(CharT* out, const char* digits, size_t numDigits);
+	static size_t CharSize(Size size)
+		{ return (size == Long) ? sizeof(wchar_t) : (size == Utf16) ? 2 : (size == Utf32) ? 4 : 1; }
+	static size_t TranscodeString(CharT* out, const void* str, Size strSize, size_t max);
+	static void FormatString(PrintfSink<CharT>& sink, const void* str, Size strSize, size_t len, int flags, int width);
+	static void FormatChar(PrintfSink<CharT>& sink, int c, Size charSize, int flags, int width);
+	static void FormatPointer(PrintfSink<CharT>& sink, const void* p, int flags, int width, int precision);
+	static CharT* GroupSeparatorBuffer()
+		{ static CharT sep[MaxGroupSeparator + 1] = { ',' }; return sep; }
+	static int my_snprintf(char* output, size_t size, const char* format, ...);
+	void OutputStaticText();
+	int CountStars(size_t pos) const;
+	int StarValue(int star);
+	static int AppendDecimal(char* out, int n);
+	size_t ParsePosition(size_t pos) const;
+	void ScanPositional();
+	void RejectPositional();
+	void OutputPositional();
+
+	const CharT* _fmt;		// the format string currently being processed
+	size_t _pos;			// current position with _fmt
+	size_t _numPositional;	// number of positional arguments, or 0 if the format isn't positional
+	size_t _numCaptured;	// number of positional arguments received so far
+	bool _deferred;			// if set, arguments are only captured (see PrintfResumable)
+	int _numStars;			// number of '*' values received for the current specification
+	int _starValues[2];		// the '*' values themselves
+	size_t _numSpecs;		// number of format specifications in a positional format
+	unsigned char _argIndex[MaxPositional];	// for each specification, the (0-based) argument it uses
+	Arg _args[MaxPositional];
+	PrintfOstreamSink<CharT> _ostmSink;	// used when we're outputting to an ostream
+	PrintfSink<CharT>& _sink;	// where we're outputting
+};
+
+//-----------------------------------------------------------------------------
+template <class CharT, class OutputT>
+inline void oprintf(OutputT& out, const CharT* fmt)
+{
+	Printf<CharT> p(out, fmt);
+}
+
+template <class CharT, class OutputT, class A1>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1;
+}
+
+template <class CharT, class OutputT, class A1, class A2>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4, class A5>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4 << a5;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4, class A5, class A6>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4 << a5 << a6;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4 << a5 << a6 << a7;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8 << a9;
+}
+
+template <class CharT, class OutputT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+void oprintf(OutputT& out, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
+{
+	Printf<CharT> p(out, fmt);
+	p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8 << a9 << a10;
+}
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+class strprintfT: public std::basic_string<CharT>
+{
+public:
+	strprintfT(const CharT* fmt)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt);
+	}
+
+	template <class A1>
+	strprintfT(const CharT* fmt, A1 a1)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1);
+	}
+
+	template <class A1, class A2>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2);
+	}
+
+	template <class A1, class A2, class A3>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3);
+	}
+
+	template <class A1, class A2, class A3, class A4>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4);
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4, a5);
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4, a5, a6);
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4, a5, a6, a7);
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4, a5, a6, a7, a8);
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9);
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
+	{
+		PrintfStringSink<CharT> sink(*this);
+		oprintf(sink, fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
+	}
+
+	operator const CharT* () const { return std::basic_string<CharT>::c_str(); }
+};
+
+typedef strprintfT<char> strprintf;
+
+typedef strprintfT<wchar_t> wstrprintf;
+
+#ifdef STREAMPRINTF_CHAR16
+typedef strprintfT<char16_t> u16strprintf;
+typedef strprintfT<char32_t> u32strprintf;
+#endif
+
+#ifdef STREAMPRINTF_CHAR8
+typedef strprintfT<char8_t> u8strprintf;
+#endif
+
+//-----------------------------------------------------------------------------
+// Compiled once, by the library.
+
+#ifdef STREAMPRINTF_LIBRARY
+extern template class PrintfOstreamSink<char>;
+extern template class PrintfOstreamSink<wchar_t>;
+extern template class Printf<char>;
+extern template class Printf<wchar_t>;
+#endif
+
+#endif // COREPRINTF_H
@@ -0,0 +1,233 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// CSV/TSV row writer built on Printf.
+//
+// Usage:
+//      CsvPrintf csv(std::cout);            // comma-separated
+//      csv.Row("%s,%d,%.2f", name, id, price);
+//
+//      CsvPrintf tsv(file, '\t');           // tab-separated
+//      tsv.Row("%s\t%s", key, value);
+//
+// Each row is written by formatting 'fmt' the same way oprintf() would.  The
+// delimiter characters in the static text of the format separate the fields;
+// any delimiter, quote, or newline that comes from an argument is data, and a
+// field that contains one is written in double quotes, with embedded quotes
+// doubled (RFC 4180).  Every row ends with "\n".
+//
+// Output goes through a PrintfBufferedSink, so it reaches the stream in large
+// blocks; call Flush() to push out what has been buffered so far.
+
+#ifndef CSVPRINTF_H
+#define CSVPRINTF_H
+
+#include "streamprintf.h"
+
+//-----------------------------------------------------------------------------
+// Returns true if any of s[0..len) is the delimiter, a quote, CR or LF, i.e.
+// if the field must be quoted.
+
+template <class CharT>
+inline bool CsvNeedsQuotes(const CharT* s, size_t len, CharT delim)
+{
+	for (size_t i = 0; i < len; ++i)
+	{
+		if (s[i] == delim || s[i] == '"' || s[i] == '\n' || s[i] == '\r')
+			return true;
+	}
+	return false;
+}
+
+#ifdef STREAMPRINTF_SSE2
+template <>
+inline bool CsvNeedsQuotes(const char* s, size_t len, char delim)
+{
+	const __m128i d = _mm_set1_epi8(delim);
+	const __m128i q = _mm_set1_epi8('"');
+	const __m128i n = _mm_set1_epi8('\n');
+	const __m128i r = _mm_set1_epi8('\r');
+	size_t i = 0;
+
+	for (; i + 16 <= len; i += 16)
+	{
+		__m128i c = _mm_loadu_si128((const __m128i*) (s + i));
+		__m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(c, d), _mm_cmpeq_epi8(c, q)),
+								   _mm_or_si128(_mm_cmpeq_epi8(c, n), _mm_cmpeq_epi8(c, r)));
+		if (_mm_movemask_epi8(hit) != 0)
+			return true;
+	}
+	for (; i < len; ++i)
+	{
+		if (s[i] == delim || s[i] == '"' || s[i] == '\n' || s[i] == '\r')
+			return true;
+	}
+	return false;
+}
+#endif
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+class CsvPrintfT
+{
+public:
+	CsvPrintfT(std::basic_ostream<CharT>& ostm, CharT delim = ',',
+			   size_t bufferSize = PrintfBufferedSink<CharT>::DefaultBufferSize)
+		: _out(ostm, bufferSize), _fields(_out, delim) {}
+
+	void Flush() { _out.Flush(); }
+
+	void Row(const CharT* fmt)
+	{
+		{ Printf<CharT> p(_fields, fmt); }
+		_fields.EndRow();
+	}
+
+	template <class A1>
+	void Row(const CharT* fmt, A1 a1)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2>
+	void Row(const CharT* fmt, A1 a1, A2 a2)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4 << a5; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4 << a5 << a6; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4 << a5 << a6 << a7; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8 << a9; }
+		_fields.EndRow();
+	}
+
+	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+	void Row(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
+	{
+		{ Printf<CharT> p(_fields, fmt); p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8 << a9 << a10; }
+		_fields.EndRow();
+	}
+
+private:
+	// Splits Printf's output into fields: a delimiter in the static text ends
+	// the current field, and everything else is collected in _field until
+	// then, so that the whole field can be checked for characters that need
+	// quoting before any of it is written.
+	class FieldSink: public PrintfSink<CharT>
+	{
+	public:
+		FieldSink(PrintfBufferedSink<CharT>& out, CharT delim) : _out(out), _delim(delim) {}
+
+		virtual void Write(const CharT* s, size_t len)
+		{
+			const CharT* end = s + len;
+			for (const CharT* p = s; p != end; ++p)
+			{
+				if (*p == _delim)
+				{
+					_field.append(s, p - s);
+					EndField();
+					_out.Put(_delim);
+					s = p + 1;
+				}
+			}
+			_field.append(s, end - s);
+		}
+
+		virtual void WriteArg(const CharT* s, size_t len)
+			{ _field.append(s, len); }
+
+		void EndRow()
+		{
+			EndField();
+			_out.Put('\n');
+		}
+
+	private:
+		void EndField()
+		{
+			const CharT* s = _field.data();
+			size_t len = _field.size();
+
+			if (!CsvNeedsQuotes(s, len, _delim))
+			{
+				_out.Write(s, len);
+			}
+			else
+			{
+				_out.Put('"');
+				for (size_t i = 0; i < len; ++i)
+				{
+					if (s[i] == '"')
+					{
+						_out.Write(s, i + 1);	// includes the quote...
+						s += i;					// ...which is written again
+						len -= i;
+						i = 0;
+					}
+				}
+				_out.Write(s, len);
+				_out.Put('"');
+			}
+			_field.clear();
+		}
+
+		PrintfBufferedSink<CharT>& _out;
+		CharT _delim;
+		std::basic_string<CharT> _field;	// reused from field to field
+	};
+
+	PrintfBufferedSink<CharT> _out;
+	FieldSink _fields;
+};
+
+typedef CsvPrintfT<char> CsvPrintf;
+
+typedef CsvPrintfT<wchar_t> WCsvPrintf;
+
+#endif // CSVPRINTF_H
@@ -0,0 +1,151 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// A sink that writes each record to a POSIX file descriptor with one
+// writev() (POSIX only).
+//
+// Usage:
+//      PrintfWritevSink audit(fd);
+//      oprintf(audit, "%s user=%s payload=%s\n", when, user, payload);
+//
+// Each oprintf() call is a record.  Instead of being copied into a buffer,
+// the static text of the format and the string arguments are referred to
+// where they are, by the entries of an iovec list; only what is converted
+// (numbers, padding, strings of another width) is copied, into a small
+// scratch buffer.  When the record is complete, the whole list is written
+// with a single writev(), so a large payload is never copied on its way to
+// the kernel.  Pieces shorter than SmallPiece are copied anyway, since an
+// iovec entry costs more than copying a few bytes.
+//
+// A record is split into several writev() calls only if what it copies
+// overflows the scratch buffer, or if it has more than MaxPieces pieces.
+//
+// The sink refers to the arguments until the end of the record, so only
+// oprintf() and the like may write to it: their arguments live until the
+// Printf they create is destroyed.  (See PrintfSink.)  It is meant for one
+// thread; give each thread a sink of its own, or lock around the call.
+
+#ifndef FDPRINTF_H
+#define FDPRINTF_H
+
+#include "streamprintf.h"
+#include <errno.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+class PrintfWritevSink: public PrintfSink<char>
+{
+public:
+	enum { DefaultScratchSize = 4096, MaxPieces = 128, SmallPiece = 64 };
+
+	explicit PrintfWritevSink(int fd, size_t scratchSize = DefaultScratchSize)
+		: _fd(fd), _scratch(new char[scratchSize]), _scratchSize(scratchSize),
+		  _scratchLen(0), _numPieces(0), _error(0) {}
+	virtual ~PrintfWritevSink()
+		{ EndRecord(); delete[] _scratch; }
+
+	virtual void Write(const char* s, size_t len)           { Copy(s, len); }
+	virtual void WriteInPlace(const char* s, size_t len)    { Refer(s, len); }
+	virtual void WriteArgInPlace(const char* s, size_t len) { Refer(s, len); }
+
+	// Writes out what has been written to the sink since the last record.
+	virtual void EndRecord()
+	{
+		Submit(_pieces, _numPieces);
+		_numPieces = 0;
+		_scratchLen = 0;
+	}
+
+	// The errno of the first write that failed, or 0.  The rest of a record
+	// that fails is discarded.
+	int Error() const { return _error; }
+
+private:
+	PrintfWritevSink(const PrintfWritevSink&);
+	PrintfWritevSink& operator=(const PrintfWritevSink&);
+
+	// text that may not outlive the call: copied to the scratch buffer, and
+	// joined to the last piece if that ends where the copy starts
+	void Copy(const char* s, size_t len)
+	{
+		if (len > _scratchSize - _scratchLen)
+		{
+			EndRecord();
+			if (len > _scratchSize)
+			{
+				iovec whole = { (void*) s, len };
+				Submit(&whole, 1);
+				return;
+			}
+		}
+
+		char* p = _scratch + _scratchLen;
+		memcpy(p, s, len);
+		_scratchLen += len;
+
+		if (_numPieces > 0 && (char*) _pieces[_numPieces - 1].iov_base + _pieces[_numPieces - 1].iov_len == p)
+			_pieces[_numPieces - 1].iov_len += len;
+		else
+			Add(p, len);
+	}
+
+	// text that stays where it is until EndRecord()
+	void Refer(const char* s, size_t len)
+	{
+		if (len < (size_t) SmallPiece)
+			Copy(s, len);
+		else
+			Add(s, len);
+	}
+
+	void Add(const char* s, size_t len)
+	{
+		if (_numPieces == (size_t) MaxPieces)
+		{
+			// the scratch buffer must stay as it is until the pieces that
+			// refer to it have been written
+			Submit(_pieces, _numPieces);
+			_numPieces = 0;
+		}
+		_pieces[_numPieces].iov_base = (void*) s;
+		_pieces[_numPieces].iov_len = len;
+		++_numPieces;
+	}
+
+	// writev() of all of iov[0..count), however many calls that takes
+	void Submit(iovec* iov, size_t count)
+	{
+		while (count > 0)
+		{
+			ssize_t n = writev(_fd, iov, (int) count);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0)
+			{
+				if (_error == 0)
+					_error = errno;
+				return;
+			}
+
+			// skip what was written, which may end part way through a piece
+			for (; count > 0 && (size_t) n >= iov->iov_len; ++iov, --count)
+				n -= iov->iov_len;
+			if (count > 0)
+			{
+				iov->iov_base = (char*) iov->iov_base + n;
+				iov->iov_len -= n;
+			}
+		}
+	}
+
+	int _fd;
+	char* _scratch;				// converted text of the current record
+	size_t _scratchSize;
+	size_t _scratchLen;
+	iovec _pieces[MaxPieces];	// the current record
+	size_t _numPieces;
+	int _error;
+};
+
+#endif // FDPRINTF_H
@@ -0,0 +1,250 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// Formatting into a stack array whose size is worked out from the format
+// string at compile time (C++14).
+//
+// Usage:
+//      // the longest "%d:%08x %hd" can possibly be, as a constant
+//      constexpr size_t n = PrintfMaxLength("%d:%08x %hd");
+//
+//      // format into a local array of exactly that size
+//      auto s = FIXEDPRINTF("%d:%08x %hd", id, flags, delta);
+//      out.write(s.c_str(), s.size());
+//
+// A format is bounded if every conversion in it is: integers, characters,
+// pointers, "%e", "%g" and "%a" always are, "%f" is unless it is "%Lf", and
+// "%s" is if it has a precision ("%.20s").  The bound doesn't depend on the
+// types of the arguments, since any integer may be written with any of the
+// int, long and long long modifiers (see IntSizeMatches()), so "%hd" is
+// allowed as much room as "%lld".  A '*' width or precision, "%Lf", or a
+// "%s" without a precision makes the format unbounded, and FIXEDPRINTF() of
+// it doesn't compile.
+//
+// Arguments with a printf_formatter aren't allowed, since what they write
+// isn't known from the format.
+
+#ifndef FIXEDPRINTF_H
+#define FIXEDPRINTF_H
+
+#include "streamprintf.h"
+
+//-----------------------------------------------------------------------------
+// What PrintfMaxLength() returns for an unbounded format.
+
+const size_t PrintfUnbounded = (size_t) -1;
+
+//-----------------------------------------------------------------------------
+// The longest text any conversion of the given kind can have, not counting
+// the width.  'conv' is the conversion character, 'precision' is -1 if there
+// is none, and 'longDouble' is set for "%L".
+
+constexpr size_t PrintfConversionMaxLength(char conv, int precision, bool grouping, bool alternate,
+										   bool longDouble)
+{
+	const size_t maxGroupSeparator = Printf<char>::MaxGroupSeparator;
+	size_t p = (precision >= 0) ? (size_t) precision : 0;
+	size_t digits = 0;
+
+	switch (conv)
+	{
+	case 'd': case 'i': case 'u':
+	case 'o': case 'x': case 'X': case 'b': case 'B':
+		// a sign or "0x", then the digits of any 64-bit value or the
+		// precision's worth of them, grouped if need be
+		digits = (conv == 'o') ? 22 : (conv == 'x' || conv == 'X') ? 16 : (conv == 'b' || conv == 'B') ? 64 : 20;
+		if (p > digits)
+			digits = p;
+		if (conv == 'o' && alternate)
+			++digits;
+		if (grouping)
+			digits += (digits - 1) / 3 * maxGroupSeparator;
+		return 2 + digits;
+
+	case 'c':
+		return 4;			// a character of another width may become several
+
+	case 's':
+		return (precision >= 0) ? p : PrintfUnbounded;
+
+	case 'p':
+		digits = 2 * sizeof(void*);
+		return 2 + ((p > digits) ? p : digits);
+
+	case 'e': case 'E':
+		// "-1.<precision>e+4932"
+		return ((precision >= 0) ? p : 6) + 9;
+
+	case 'g': case 'G':
+		// "-0.0000<precision>" or "-1.<precision - 1>e+4932"; when grouped,
+		// all the digits may be in front of the decimal point
+		p = (precision < 0) ? 6 : (p == 0) ? 1 : p;
+		return p + 8 + (grouping ? (p - 1) / 3 * maxGroupSeparator : 0);
+
+	case 'f': case 'F':
+		if (longDouble)
+			return PrintfUnbounded;
+		digits = DBL_MAX_10_EXP + 1;
+		if (grouping)
+			digits += (digits - 1) / 3 * maxGroupSeparator;
+		return 1 + digits + 1 + ((precision >= 0) ? p : 6);
+
+	case 'a': case 'A':
+		// "-0x1.<precision>p+16383"; without a precision, as many hex digits
+		// as the widest long double needs
+		return ((precision >= 0) ? p : 28) + 12;
+
+	default:
+		return PrintfUnbounded;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Returns the greatest number of characters (not counting the terminating
+// NUL) that the format can produce, or PrintfUnbounded.
+
+template <class CharT>
+constexpr size_t PrintfMaxLength(const CharT* fmt)
+{
+	size_t total = 0;
+	size_t i = 0;
+
+	while (fmt[i] != '\0')
+	{
+		if (fmt[i] != '%' || fmt[i+1] == '%')
+		{
+			++total;
+			i += (fmt[i] == '%') ? 2 : 1;
+			continue;
+		}
+		++i;
+
+		// "n$"
+		size_t j = i;
+		while (fmt[j] >= '0' && fmt[j] <= '9')
+			++j;
+		if (j != i && fmt[j] == '$')
+			i = j + 1;
+
+		bool grouping = false;
+		bool alternate = false;
+		for (; fmt[i] == '-' || fmt[i] == '+' || fmt[i] == ' ' || fmt[i] == '#' || fmt[i] == '0' || fmt[i] == '\''; ++i)
+		{
+			grouping = grouping || fmt[i] == '\'';
+			alternate = alternate || fmt[i] == '#';
+		}
+
+		if (fmt[i] == '*')
+			return PrintfUnbounded;
+		size_t width = 0;
+		for (; fmt[i] >= '0' && fmt[i] <= '9'; ++i)
+			width = width*10 + (fmt[i] - '0');
+
+		int precision = -1;
+		if (fmt[i] == '.')
+		{
+			if (fmt[++i] == '*')
+				return PrintfUnbounded;
+			precision = 0;
+			for (; fmt[i] >= '0' && fmt[i] <= '9'; ++i)
+				precision = precision*10 + (fmt[i] - '0');
+		}
+
+		bool longDouble = false;
+		if (fmt[i] == 'I' && fmt[i+1] == '6' && fmt[i+2] == '4')
+			i += 3;
+		for (; fmt[i] == 'h' || fmt[i] == 'l' || fmt[i] == 'L' || fmt[i] == 'z' || fmt[i] == 'j' || fmt[i] == 't'; ++i)
+			longDouble = longDouble || fmt[i] == 'L';
+
+		CharT conv = fmt[i++];
+		if (conv == 'C')
+			conv = 'c';
+		else if (conv == 'S')
+			conv = 's';
+		size_t len = (conv > 0 && conv < 128)
+			? PrintfConversionMaxLength((char) conv, precision, grouping, alternate, longDouble)
+			: PrintfUnbounded;
+		if (len == PrintfUnbounded)
+			return PrintfUnbounded;
+		total += (width > len) ? width : len;
+	}
+	return total;
+}
+
+//-----------------------------------------------------------------------------
+// Writes to an array that is known to be long enough.
+
+template <class CharT>
+class PrintfArraySink: public PrintfSink<CharT>
+{
+public:
+	PrintfArraySink(CharT* p, size_t size) : _p(p), _end(p + size) {}
+	virtual void Write(const CharT* s, size_t len)
+	{
+		assertmsg(len <= (size_t) (_end - _p), "printf: Output is longer than its bound");
+		memcpy(_p, s, len * sizeof(CharT));
+		_p += len;
+	}
+	CharT* End() const { return _p; }
+
+private:
+	CharT* _p;
+	CharT* _end;
+};
+
+//-----------------------------------------------------------------------------
+template <class... Args>
+struct PrintfAnyFormatter
+{
+	enum { value = false };
+};
+
+template <class A, class... Args>
+struct PrintfAnyFormatter<A, Args...>
+{
+	enum { value = printf_has_formatter<A>::value || PrintfAnyFormatter<Args...>::value };
+};
+
+//-----------------------------------------------------------------------------
+// The result of fixedprintf(): N characters and a NUL, on the stack.
+
+template <class CharT, size_t N>
+class PrintfFixedString
+{
+public:
+	template <class... Args>
+	PrintfFixedString(const CharT* fmt, const Args&... args)
+	{
+		static_assert(!PrintfAnyFormatter<Args...>::value,
+					  "fixedprintf: Arguments with a printf_formatter have no bound");
+		PrintfArraySink<CharT> sink(_s, N);
+		oprintf(sink, fmt, args...);
+		_len = sink.End() - _s;
+		_s[_len] = '\0';
+	}
+
+	const CharT* c_str() const { return _s; }
+	size_t size() const        { return _len; }
+	operator const CharT* () const { return _s; }
+
+private:
+	CharT _s[N + 1];
+	size_t _len;
+};
+
+//-----------------------------------------------------------------------------
+// Formats into a PrintfFixedString of N characters, which must be at least
+// PrintfMaxLength(fmt).  FIXEDPRINTF() works N out from the format, which
+// must be a string literal (or some other constant).
+
+template <size_t N, class CharT, class... Args>
+inline PrintfFixedString<CharT, N> fixedprintf(const CharT* fmt, const Args&... args)
+{
+	static_assert(N != PrintfUnbounded, "fixedprintf: The format has no bound");
+	return PrintfFixedString<CharT, N>(fmt, args...);
+}
+
+#define FIXEDPRINTF(...) fixedprintf<PrintfMaxLength(FIXEDPRINTF_FORMAT(__VA_ARGS__, 0))>(__VA_ARGS__)
+#define FIXEDPRINTF_FORMAT(fmt, ...) fmt
+
+#endif // FIXEDPRINTF_H
@@ -0,0 +1,117 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// Level-gated logging built on oprintf().
+//
+// Usage:
+//      LOGPRINTF_INFO("listening on port %d\n", port);
+//      LOGPRINTF_DEBUG("request %s took %.3f ms\n", id, Elapsed(start));
+//
+//      PrintfLog::SetLevel(PrintfLog::Debug);   // at run time
+//      PrintfLog::SetSink(&mySink);             // default: std::clog
+//
+// The level is checked before any of the arguments are evaluated, so a
+// statement whose level is off costs one relaxed atomic load, and
+// "Elapsed(start)" above isn't even called.
+//
+// Statements below LOGPRINTF_MIN_LEVEL are stripped at compile time: the
+// condition is a constant, so the compiler drops the statement, but the
+// statement is still compiled, so an argument that Printf can't take, or a
+// format that isn't a string of the right character type, is still an error.
+// (The check of each argument against its specification, like everything
+// Printf checks, is done when the statement runs.)  Define LOGPRINTF_MIN_LEVEL
+// to one of these numbers before including this file:
+//      0 Trace, 1 Debug, 2 Info, 3 Warn, 4 Error, 5 nothing at all
+
+#ifndef LOGPRINTF_H
+#define LOGPRINTF_H
+
+#include "streamprintf.h"
+
+#if __cplusplus >= 201103L || (defined(_MSC_VER) && _MSC_VER >= 1700)
+	#include <atomic>
+	#define LOGPRINTF_ATOMIC
+#endif
+
+#ifndef LOGPRINTF_MIN_LEVEL
+	#define LOGPRINTF_MIN_LEVEL 0
+#endif
+
+//-----------------------------------------------------------------------------
+// The run-time level and the sink are template statics so that this can be
+// header-only; the level is constant-initialized, with no guard to check.
+
+template <class Dummy>
+struct PrintfLogData
+{
+#ifdef LOGPRINTF_ATOMIC
+	static std::atomic<int> level;
+#else
+	static volatile int level;		// an int is read and written whole everywhere we run
+#endif
+	static PrintfSink<char>* sink;
+};
+
+#ifdef LOGPRINTF_ATOMIC
+template <class Dummy> std::atomic<int> PrintfLogData<Dummy>::level(2);
+#else
+template <class Dummy> volatile int PrintfLogData<Dummy>::level = 2;
+#endif
+template <class Dummy> PrintfSink<char>* PrintfLogData<Dummy>::sink = 0;
+
+//-----------------------------------------------------------------------------
+class PrintfLog
+{
+public:
+	enum Level { Trace, Debug, Info, Warn, Error, Off };
+
+	// Statements of this level and above are written.  The default is Info.
+	static void SetLevel(int level)
+	{
+#ifdef LOGPRINTF_ATOMIC
+		PrintfLogData<void>::level.store(level, std::memory_order_relaxed);
+#else
+		PrintfLogData<void>::level = level;
+#endif
+	}
+
+	static int GetLevel()
+	{
+#ifdef LOGPRINTF_ATOMIC
+		return PrintfLogData<void>::level.load(std::memory_order_relaxed);
+#else
+		return PrintfLogData<void>::level;
+#endif
+	}
+
+	static bool Enabled(int level)
+		{ return level >= GetLevel(); }
+
+	// Where the output goes; NULL means std::clog.  Set it before logging
+	// starts, and make it safe to write to from all the threads that log.
+	static void SetSink(PrintfSink<char>* sink)
+		{ PrintfLogData<void>::sink = sink; }
+
+	static PrintfSink<char>& Sink()
+	{
+		static PrintfOstreamSink<char> clogSink(&std::clog);
+		PrintfSink<char>* sink = PrintfLogData<void>::sink;
+		return sink ? *sink : clogSink;
+	}
+};
+
+//-----------------------------------------------------------------------------
+#define LOGPRINTF(level, ...)                                                 \
+	do                                                                        \
+	{                                                                         \
+		if ((level) >= LOGPRINTF_MIN_LEVEL && PrintfLog::Enabled(level))      \
+			oprintf(PrintfLog::Sink(), __VA_ARGS__);                          \
+	} while (0)
+
+#define LOGPRINTF_TRACE(...) LOGPRINTF(PrintfLog::Trace, __VA_ARGS__)
+#define LOGPRINTF_DEBUG(...) LOGPRINTF(PrintfLog::Debug, __VA_ARGS__)
+#define LOGPRINTF_INFO(...)  LOGPRINTF(PrintfLog::Info,  __VA_ARGS__)
+#define LOGPRINTF_WARN(...)  LOGPRINTF(PrintfLog::Warn,  __VA_ARGS__)
+#define LOGPRINTF_ERROR(...) LOGPRINTF(PrintfLog::Error, __VA_ARGS__)
+
+#endif // LOGPRINTF_H
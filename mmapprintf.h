@@ -0,0 +1,262 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// A sink that appends to a file through a memory mapping (POSIX, C++11).
+//
+// Usage:
+//      PrintfMmapSink trace("trace.log");
+//      oprintf(trace, "%llu %s %d\n", tick, event, value);
+//
+// Output is copied straight into a shared mapping of the end of the file,
+// so no system call is made for a record: the file is extended and mapped
+// 'extent' bytes at a time (64 MB by default), and only when an extent is full
+// is it unmapped and the next one mapped.  On Linux the space of each extent
+// is allocated with fallocate(), so that running out of disk space is found
+// out then, not by a SIGBUS while writing; elsewhere, or where the file
+// system can't do that, the file is just extended with ftruncate().
+//
+// A background thread msync()s what has been written every 'syncInterval'
+// milliseconds (a second by default), so the writer never waits for the
+// disk; Sync() does it at once.  A full extent is handed to that thread too,
+// which syncs the rest of it and unmaps it.  When the sink is destroyed, the
+// file is truncated to the length of what was actually written.
+//
+// The file is appended to if it exists.  Only one thread may write to the
+// sink at a time.
+
+#ifndef MMAPPRINTF_H
+#define MMAPPRINTF_H
+
+#include "streamprintf.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//-----------------------------------------------------------------------------
+class PrintfMmapSink: public PrintfSink<char>
+{
+public:
+	enum { DefaultExtent = 64 * 1024 * 1024, DefaultSyncInterval = 1000 };
+
+	explicit PrintfMmapSink(const char* path, size_t extent = DefaultExtent,
+							int syncInterval = DefaultSyncInterval)
+		: _fd(open(path, O_RDWR | O_CREAT, 0644)), _extent(extent), _map(NULL),
+		  _mapOffset(0), _mapSize(0), _pos(0), _syncedMap(NULL), _syncedPos(0), _stop(false), _error(0)
+	{
+		struct stat st;
+		if (_fd < 0 || fstat(_fd, &st) != 0)
+		{
+			_error = errno;
+			if (_fd >= 0)
+				close(_fd);
+			_fd = -1;
+			return;
+		}
+
+		// the first extent starts at the page that holds the end of the file
+		size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+		_mapOffset = st.st_size - st.st_size % pageSize;
+		_pos = (size_t) (st.st_size - _mapOffset);
+		Remap(0);
+
+		_syncer = std::thread(&PrintfMmapSink::SyncLoop, this, syncInterval);
+	}
+
+	virtual ~PrintfMmapSink()
+	{
+		if (_syncer.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_one();
+			_syncer.join();
+		}
+
+		for (size_t i = 0; i < _retired.size(); ++i)
+			munmap(_retired[i].map, _retired[i].size);
+		if (_map != NULL)
+			munmap(_map, _mapSize);
+		if (_fd >= 0)
+		{
+			// give back what was allocated but not written
+			if (ftruncate(_fd, _mapOffset + _pos) != 0 && _error == 0)
+				_error = errno;
+			close(_fd);
+		}
+	}
+
+	virtual void Write(const char* s, size_t len)
+	{
+		if (_map == NULL)
+			return;				// see Error()
+
+		size_t pos = _pos.load(std::memory_order_relaxed);
+		while (len > _mapSize - pos)
+		{
+			size_t n = _mapSize - pos;
+			memcpy(_map + pos, s, n);
+			s += n;
+			len -= n;
+			_pos.store(pos + n, std::memory_order_relaxed);
+			Remap(len);
+			if (_map == NULL)
+				return;
+			pos = _pos.load(std::memory_order_relaxed);
+		}
+		memcpy(_map + pos, s, len);
+		_pos.store(pos + len, std::memory_order_relaxed);
+	}
+
+	// Writes what has been written so far to the disk, and waits for it.
+	// Call it from the thread that writes.
+	void Sync() { SyncMappings(); }
+
+	// The errno of the first thing that failed, or 0.  If the file can't be
+	// opened or extended, output is discarded.
+	int Error() const { return _error; }
+
+private:
+	PrintfMmapSink(const PrintfMmapSink&);
+	PrintfMmapSink& operator=(const PrintfMmapSink&);
+
+	// an extent that has been written to
+	struct Mapping
+	{
+		char* map;
+		size_t size;
+		size_t len;		// how much of it was written
+	};
+
+	// Maps the next extent, which starts at the page that holds the end of
+	// what has been written and has room for at least 'need' more bytes.
+	// The old one is left to the syncer thread, which is the only one that
+	// waits for the disk or unmaps anything.
+	void Remap(size_t need)
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+
+		if (_map != NULL)
+		{
+			Mapping old = { _map, _mapSize, _pos.load(std::memory_order_relaxed) };
+			_retired.push_back(old);
+			_map = NULL;
+			_wake.notify_one();
+		}
+
+		size_t pageSize = (size_t) sysconf(_SC_PAGESIZE);
+		off_t end = _mapOffset + _pos;
+		off_t offset = end - end % pageSize;
+		size_t size = (size_t) (end - offset) + need;
+		size = (size < _extent) ? _extent : (size + pageSize - 1) / pageSize * pageSize;
+
+		if (!Allocate(offset + size))
+			return;
+		void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, offset);
+		if (map == MAP_FAILED)
+		{
+			Fail();
+			return;
+		}
+
+		_map = (char*) map;
+		_mapOffset = offset;
+		_mapSize = size;
+		_pos = (size_t) (end - offset);
+	}
+
+	bool Allocate(off_t length)
+	{
+		struct stat st;
+		if (fstat(_fd, &st) != 0)
+			return Fail();
+		if (st.st_size >= length)
+			return true;
+#ifdef __linux__
+		if (fallocate(_fd, 0, st.st_size, length - st.st_size) == 0)
+			return true;
+		if (errno != EOPNOTSUPP)
+			return Fail();
+#endif
+		return ftruncate(_fd, length) == 0 || Fail();
+	}
+
+	bool Fail()
+	{
+		if (_error == 0)
+			_error = errno;
+		return false;
+	}
+
+	// msync()s what has been written to the current extent and to the
+	// retired ones, and unmaps the retired ones.  _mutex is held only to
+	// look at them, not while waiting for the disk; the current extent can't
+	// be unmapped meanwhile, since only this function unmaps a mapping
+	// before the sink is destroyed.
+	void SyncMappings()
+	{
+		std::lock_guard<std::mutex> syncLock(_syncMutex);
+
+		std::vector<Mapping> retired;
+		char* map;
+		size_t pos;
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			retired.swap(_retired);
+			map = _map;
+			pos = _pos.load(std::memory_order_relaxed);
+		}
+
+		for (size_t i = 0; i < retired.size(); ++i)
+		{
+			if (retired[i].map != _syncedMap || retired[i].len != _syncedPos)
+				msync(retired[i].map, retired[i].len, MS_SYNC);
+			munmap(retired[i].map, retired[i].size);
+		}
+		if (map != NULL && (map != _syncedMap || pos != _syncedPos))
+			msync(map, pos, MS_SYNC);
+		_syncedMap = map;
+		_syncedPos = pos;
+	}
+
+	void SyncLoop(int interval)
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (!_stop)
+		{
+			_wake.wait_for(lock, std::chrono::milliseconds(interval));
+			lock.unlock();
+			SyncMappings();
+			lock.lock();
+		}
+	}
+
+	int _fd;
+	size_t _extent;
+	char* _map;					// the current extent
+	off_t _mapOffset;			// where in the file it starts
+	size_t _mapSize;
+	std::atomic<size_t> _pos;	// how much of it has been written
+	std::vector<Mapping> _retired;	// full extents, still to be synced and unmapped
+
+	std::mutex _syncMutex;		// held while msync()ing
+	char* _syncedMap;			// the mapping last msync()ed, and how much of it
+	size_t _syncedPos;
+
+	std::mutex _mutex;			// guards the mapping against the syncer
+	std::condition_variable _wake;
+	std::thread _syncer;
+	bool _stop;
+	int _error;
+};
+
+#endif // MMAPPRINTF_H
@@ -0,0 +1,14 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// The compiled part of the streamprintf library: Printf<char> and
+// Printf<wchar_t>, for code that includes only coreprintf.h.  Any of the
+// options at the top of streamprintf.h (STREAMPRINTF_C_LOCALE and the like)
+// must be defined here, when the library is built.
+
+#include "streamprintf.h"
+
+template class PrintfOstreamSink<char>;
+template class PrintfOstreamSink<wchar_t>;
+template class Printf<char>;
+template class Printf<wchar_t>;
@@ -8,9 +8,16 @@
 //      ostream o = ...;
 //      oprintf(o, "%s %d\n", "hello", 3);
 //
+//      // printf-style writing of each element of an array
+//      oprintf_array(std::cout, "%u\n", ids, count);
+//
+//      // printf-style writing to any PrintfSink, e.g. a buffered one
+//      PrintfBufferedSink<char> sink(std::cout);
+//      oprintf(sink, "%s %d\n", "hello", 3);
+//
 //      // printf-style writing to a C++ string
 //      string s = strprintf("%s %d\n", "hello", 3);
-//      wstring ws = wstrprintf(L"%s %d\n", L"hello", 3); // Windows only
+//      wstring ws = wstrprintf(L"%s %d\n", L"hello", 3);
 //
 //      // printf-style passing of an argument to any function which has
 //      // a (const char*) argument, without having to first explicitly
@@ -36,544 +43,2500 @@
 
 
 //-----------------------------------------------------------------------------
-// If STREAMPRINTF_STRICT_INTSIZE is defined, then 'int' and 'long' are treated
-// as incompatible types.  For example, if this is defined, then the following
-// lines would cause runtime assertions:
+// If STREAMPRINTF_STRICT_INTSIZE is defined, then 'int', 'long' and
+// 'long long' are treated as incompatible types.  For example, if this is
+// defined, then the following lines would cause runtime assertions:
 //      int i = 0;
-//      int l = 0;
+//      long l = 0;
 //      oprintf(cout, "%ld", i);
 //      oprintf(cout, "%d", l);
 
 // #define STREAMPRINTF_STRICT_INTSIZE
 
 
+//-----------------------------------------------------------------------------
+// If STREAMPRINTF_C_LOCALE is defined, then the output never depends on the
+// locale.  Floating-point numbers, the only thing still formatted by the C
+// runtime, are formatted in the "C" locale whatever setlocale() has been
+// called with, so the decimal point is always '.'.  Nothing else looks at the
+// locale in any case: integers, strings, and digit grouping are converted
+// natively, strprintf() formats straight into its string, and output goes to
+// an ostream with write(), which uses none of its facets.
+
+// #define STREAMPRINTF_C_LOCALE
+
+
+#ifndef STREAMPRINTF_H
+#define STREAMPRINTF_H
+
 #include <assert.h>
 #include <stdarg.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <ctype.h>
-#ifdef _MSC_VER
-	#include <malloc.h>
+#include <float.h>
+#include <wchar.h>
+#ifdef STREAMPRINTF_C_LOCALE
+	#include <locale.h>
+	#ifdef __APPLE__
+		#include <xlocale.h>
+	#endif
 #endif
 
 #ifndef _MSC_VER
 	#include <sys/types.h>
 #endif
 
+// C++20 coroutines
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+	#define STREAMPRINTF_COROUTINES
+#endif
+
 #include <iostream>
 #include <sstream>
 #include <string>
-
-#ifndef NDEBUG
-	#if _MSC_VER >= 1400
-		#define assertmsg(exp, msg) (void)( (exp) || (_wassert(_CRT_WIDE(msg), _CRT_WIDE(__FILE__), __LINE__), 0) )
-	#elif defined(_MSC_VER)
-		#define assertmsg(exp, msg) (void)( (exp) || (_assert(msg, __FILE__, __LINE__), 0) )
-	#else
-		#define assertmsg(exp, msg) (void)( (exp) || (__assert(msg, __FILE__, __LINE__), 0) )
-	#endif
-	#define PRINTF_TYPE(n) n
-#else
-	#define assertmsg(exp, msg) assert(exp)
-	#define PRINTF_TYPE(n) 0
+#include <string.h>
+#include <vector>
+#ifdef STREAMPRINTF_COROUTINES
+	#include <coroutine>
+	#include <iterator>
+	#include <memory>
+	#include <string_view>
 #endif
 
-template <class CharT>
-class Printf
+// the sinks, the declaration of Printf, oprintf() and strprintf()
+#include "coreprintf.h"
+
+//-----------------------------------------------------------------------------
+// Integer-to-decimal conversion kernel.  With SSE2 (part of the x86-64
+// baseline, so it is selected at compile time rather than by a run-time
+// check) the eight digits of each 8-digit block are computed in parallel in
+// one register; elsewhere a scalar two-digits-at-a-time loop is used.
+//
+// Decimal() writes the digits of u to 'out' and returns how many it wrote.
+// It may store up to 8 bytes past the last digit, so 'out' must have room
+// for at least MaxDigits + 8 characters.
+
+class PrintfDigits
 {
+public:
 	#ifdef _MSC_VER
-	typedef __int64 INT64;
 	typedef unsigned __int64 UINT64;
 	#else
-	typedef __int64_t INT64;
-	typedef __uint64_t UINT64;
+	typedef unsigned long long UINT64;
 	#endif
 
-public:
-	Printf(std::basic_ostream<CharT>& ostm, const CharT* fmt) : _ostm(ostm), _fmt(fmt), _pos(0)
-		{ OutputStaticText(); }
-	~Printf()
-		{ assertmsg( _fmt[_pos] == '\0', "printf: Too few arguments" ); }
-
-	Printf& operator<<(bool n)                 { Do(PRINTF_TYPE(None | Int), n); return *this; }
-	Printf& operator<<(short n)                { Do(PRINTF_TYPE(Short| Int), n); return *this; }
-	Printf& operator<<(int n)                  { Do(PRINTF_TYPE(None | Int), n); return *this; }
-	Printf& operator<<(long n)                 { Do(PRINTF_TYPE(Long | Int), n); return *this; }
-	Printf& operator<<(INT64 n)                { Do(PRINTF_TYPE(Int64| Int), n); return *this; }
-
-	Printf& operator<<(unsigned short u)       { Do(PRINTF_TYPE(Short| Unsigned), u); return *this; }
-	Printf& operator<<(unsigned int u)         { Do(PRINTF_TYPE(None | Unsigned), u); return *this; }
-	Printf& operator<<(unsigned long u)        { Do(PRINTF_TYPE(Long | Unsigned), u); return *this; }
-	Printf& operator<<(UINT64 u)               { Do(PRINTF_TYPE(Int64| Unsigned), u); return *this; }
-
-	Printf& operator<<(float f)                { Do(PRINTF_TYPE(None | Float), f); return *this; }
-	Printf& operator<<(double f)               { Do(PRINTF_TYPE(None | Float), f); return *this; }
-	Printf& operator<<(long double f)          { Do(PRINTF_TYPE(Long | Float), f); return *this; }
-
-	Printf& operator<<(char c)                 { Do(PRINTF_TYPE(Short| Char), c); return *this; }
-	Printf& operator<<(unsigned char c)        { Do(PRINTF_TYPE(Short| Char), c); return *this; }
-
-	Printf& operator<<(const char* s)          { Do(PRINTF_TYPE(Short| String), s); return *this; }
-	Printf& operator<<(const unsigned char* s) { Do(PRINTF_TYPE(Short| String), s); return *this; }
-	Printf& operator<<(const std::string& s)   { Do(PRINTF_TYPE(Short| String), s.c_str()); return *this; }
-
-	Printf& operator<<(const wchar_t* w)       { Do(PRINTF_TYPE(Long | String), w); return *this; }
-	Printf& operator<<(const std::wstring& w)  { Do(PRINTF_TYPE(Long | String), w.c_str()); return *this; }
-
-	Printf& operator<<(const void* v)          { Do(PRINTF_TYPE(None | Pointer), v); return *this; }
-
-protected:
-	enum Size { None=1, Short=2, Long=3, Int64=4, sizeMask=0xFF };
-	enum Type { Int=0x100, Unsigned=0x200, Float=0x300, Char=0x400, String=0x500,
-				WideString=0x600, Pointer=0x700, typeMask=0xFF00 };
-
-	void Do(int sizeAndType, ...);
-	void my_vsprintf(CharT* output, size_t width, const CharT* format, va_list vl);
-	void OutputStaticText();
-
-	const CharT* _fmt;		// the format string currently being processed
-	size_t _pos;			// current position with _fmt
-	std::basic_ostream<CharT>& _ostm;	// stream to which we're outputting
-};
-
-//-----------------------------------------------------------------------------
-// If you want to use wvsprintf() instead of vsprintf(), you can do that by
-// changing the two lines below from "vsprintf" and "vswprintf" to "wvsprintfA"
-// and "wvsprintfW" respectively.  Note that the C runtime routines and the
-// Windows routines aren't 100% identical in behavior, and there are a few
-// parts of the code that assume the behavior of vs[w]printf().  For example,
-// the code supports the "%I64" format specifier for 64-bit integers, but
-// wvsprintf() does not support that.
+	enum { MaxDigits = 64, Slack = 8 };	// 64 binary digits in 64 bits
 
-template <>
-inline void Printf<char>::my_vsprintf(char* output, size_t width, const char* format, va_list vl)
-{
-	#if _MSC_VER >= 1400
-		vsprintf_s(output, width, format, vl);
+	static size_t Decimal(char* out, UINT64 u)
+	{
+	#ifdef STREAMPRINTF_SSE2
+		return DecimalSSE2(out, u);
 	#else
-		vsprintf(output, format, vl);
+		return DecimalScalar(out, u);
 	#endif
-}
+	}
 
-#ifdef _MSC_VER
-template <>
-inline void Printf<wchar_t>::my_vsprintf(wchar_t* output, size_t width, const wchar_t* format, va_list vl)
-{
-	#if _MSC_VER >= 1400
-		vswprintf_s(output, width, format, vl);
-	#else
-		vswprintf(output, format, vl);
-	#endif
-}
-#endif
+	static size_t DecimalScalar(char* out, UINT64 u)
+	{
+		char tmp[MaxDigits];
+		char* p = tmp + MaxDigits;
 
-//-----------------------------------------------------------------------------
-template <class CharT>
-void Printf<CharT>::Do(int sizeAndType, ...)
-{
-#ifndef NDEBUG
-	Size size = (Size) (sizeAndType & sizeMask);
-	Type type = (Type) (sizeAndType & typeMask);
-#endif
-	va_list vl;
-	CharT format[30];
-	int i = 0;
-	CharT* result;
-	CharT sizeChar;
-	CharT fmtChar;
-	int width = 0;
-	int precision = 0;
+		while (u >= 100)
+		{
+			unsigned r = (unsigned) (u % 100);
+			u /= 100;
+			p -= 2;
+			memcpy(p, Pairs() + r*2, 2);
+		}
+		if (u >= 10)
+		{
+			p -= 2;
+			memcpy(p, Pairs() + (unsigned) u * 2, 2);
+		}
+		else
+		{
+			*--p = (char) ('0' + (unsigned) u);
+		}
 
-#ifndef NDEBUG
-	const char* legalPrintfTypeChars;
+		size_t n = tmp + MaxDigits - p;
+		memcpy(out, p, n);
+		return n;
+	}
 
-	switch (type)
+	// Hexadecimal (shift == 4) or octal (shift == 3) digits of u.
+	static size_t Radix(char* out, UINT64 u, int shift, bool upper)
 	{
-#ifdef STREAMPRINTF_STRICT_SIGN
-	case Int:        legalPrintfTypeChars = "dioxX"; break;
-	case Unsigned:   legalPrintfTypeChars = "uoxX";  break;
-#else
-	case Int:
-	case Unsigned:   legalPrintfTypeChars = "diuoxX"; break;
-#endif
-	case Float:      legalPrintfTypeChars = "eEfgG"; break;
-	case Char:       legalPrintfTypeChars = "c";     break;
-	case String:     legalPrintfTypeChars = "sp";    break;
-	case Pointer:    legalPrintfTypeChars = "p";     break;
-	default:         assert(false);
+		const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+		const unsigned mask = (1u << shift) - 1;
+		size_t n = 1;
+		while (n * shift < 64 && (u >> (n * shift)) != 0)
+			++n;
+		for (size_t i = n; i-- > 0; u >>= shift)
+			out[i] = digits[(unsigned) u & mask];
+		return n;
 	}
-#endif
-
-	format[i++] = _fmt[_pos++];
-	assertmsg(format[0] == '%', "printf: Too many arguments");
-
-	// flags
-	while (strchr("-+0 #", _fmt[_pos]))
-		format[i++] = _fmt[_pos++];
 
-	// width
-	if (isdigit(_fmt[_pos]))
+	// Binary digits of u.  Each byte of u is spread into eight ASCII digits at
+	// once: multiplying by 0x0101010101010101 copies the byte into every byte
+	// of a 64-bit word, the mask keeps a different bit in each, and adding
+	// 0x7F to each byte carries a set bit into its top bit.
+	static size_t Binary(char* out, UINT64 u)
 	{
-		while (isdigit(_fmt[_pos]))
+		const UINT64 ones = 0x0101010101010101ULL;
+		const UINT64 mask = LittleEndian() ? 0x0102040810204080ULL : 0x8040201008040201ULL;
+		char tmp[64];
+		size_t n = BitLength(u);
+
+		for (size_t i = 0; i < (n + 7) / 8; ++i)
 		{
-			format[i++] = _fmt[_pos++];
-			width = (width*10) + (format[i-1] - '0');
+			UINT64 spread = ((unsigned) (u >> (8 * i)) & 0xFF) * ones & mask;
+			spread = (((spread + 0x7F * ones) >> 7) & ones) + '0' * ones;
+			memcpy(tmp + 56 - 8 * i, &spread, 8);
 		}
+		memcpy(out, tmp + 64 - n, n);
+		return n;
 	}
 
-	// precision
-	if (_fmt[_pos] == '.')
+	// number of significant bits in u, but at least 1
+	static size_t BitLength(UINT64 u)
 	{
-		format[i++] = _fmt[_pos++];
-		while (isdigit(_fmt[_pos]))
+		size_t high = 0;
+		for (size_t step = 32; step > 0; step >>= 1)
 		{
-			format[i++] = _fmt[_pos++];
-			precision = (precision*10) + (format[i-1] - '0');
+			if ((u >> (high + step)) != 0)
+				high += step;
 		}
+		return high + 1;
 	}
 
-	// size
-	if (strchr("hlL", _fmt[_pos]) != NULL)
-	{
-		sizeChar = format[i++] = _fmt[_pos++];
-		if (sizeChar == 'L')
-			sizeChar = 'l';
-	}
-	else if (_fmt[_pos] == 'I' && _fmt[_pos+1] == '6' && _fmt[_pos+2] == '4')
+	static bool LittleEndian()
 	{
-		sizeChar = format[i++] = _fmt[_pos++];
-		format[i++] = _fmt[_pos++];
-		format[i++] = _fmt[_pos++];
-	}
-	else
-	{
-		sizeChar = '\0';
+		const unsigned one = 1;
+		return *(const char*) &one == 1;
 	}
 
-	assertmsg(_fmt[_pos] != '\0', "printf: Invalid format specification");
-	fmtChar = format[i++] = _fmt[_pos++];
-
-	if (sizeChar == '\0')
+	// The "h.hhhp+d" part of a "%a" conversion (everything after the "0x")
+	// of the number lead.frac * 2^exp, where frac holds 'fracBits' bits,
+	// left-aligned.  'precision' is the number of hex digits after the point,
+	// or -1 for as many as it takes to be exact.  Rounds to nearest even.
+	static size_t HexFloat(char* out, unsigned lead, UINT64 frac, int fracBits, int exp,
+						   int precision, bool alt, bool upper)
 	{
-		switch (fmtChar)
+		const char* hex = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+		int numDigits = (fracBits + 3) / 4;
+
+		if (precision < 0)
 		{
-		case 'c':
-		case 's':
-			sizeChar = (sizeof(CharT) == sizeof(char)) ? 'h' : 'l';
-			break;
-		case 'C':
-		case 'S':
-			sizeChar = (sizeof(CharT) == sizeof(char)) ? 'l' : 'h';
-			break;
+			precision = numDigits;
+			while (precision > 0 && ((frac >> (64 - 4 * precision)) & 0xF) == 0)
+				--precision;
 		}
-	}
-
-	if (fmtChar == 'C')
-		fmtChar = 'c';
-	else if (fmtChar == 'S')
-		fmtChar = 's';
+		else if (precision < numDigits)
+		{
+			UINT64 kept = (precision == 0) ? 0 : frac >> (64 - 4 * precision);
+			UINT64 rest = frac << (4 * precision);
+			UINT64 half = (UINT64) 1 << 63;
+			unsigned odd = (precision == 0) ? (lead & 1) : (unsigned) (kept & 1);
 
-	assertmsg(i < sizeof(format) / sizeof(format[0]), "printf: Format specification is too long");
-	format[i] = '\0';
+			if (rest > half || (rest == half && odd))
+			{
+				++kept;
+				if (precision == 0 || (kept >> (4 * precision)) != 0)
+				{
+					++lead;
+					kept = 0;
+				}
+			}
+			frac = (precision == 0) ? 0 : kept << (64 - 4 * precision);
+		}
 
-#ifndef NDEBUG
-	// Do the type-checking.  Characters and strings are tricky.
-	if (type == String && fmtChar == 'p')
-	{
-		assertmsg(sizeChar == '\0', "printf: Invalid format specification");
-	}
-	else if (type == Unsigned && size == Short)
-	{
-		// unsigned short can either mean an unsigned short integer,
-		// or a wchar_t
-		if (fmtChar == 'c')	// wchar_t is intended, so width must be 'l'
-			assertmsg(sizeChar == 'l', "printf: Type mismatch");
-		else				// unsigned short is intended, so width must be 'h'
-			assertmsg(sizeChar == 'h', "printf: Type mismatch");
-	}
-	else
-	{
-		switch (size)
+		if (lead == 16)
 		{
-#ifdef STREAMPRINTF_STRICT_INTSIZE
-		case None:
-			assertmsg(sizeChar == '\0', "printf: Type mismatch");
-			break;
-		case Long:
-			assertmsg(sizeChar == 'l', "printf: Type mismatch");
-			break;
-#else
-		case None:
-		case Long:
-			assert(sizeof(int) == sizeof(long));
-			assertmsg(sizeChar == '\0' || sizeChar == 'l', "printf: Type mismatch");
-			break;
-#endif
-		case Short:
-			assertmsg(sizeChar == 'h', "printf: Type mismatch");
-			break;
-		case Int64:
-			assertmsg(sizeChar == 'I', "printf: Type mismatch");
-			break;
-		case sizeMask: ; // to prevent gcc warning
+			lead = 1;				// rounding carried out of a 4-bit lead digit
+			exp += 4;
 		}
-	}
 
-	if (type == Unsigned && size == Short)
-		assertmsg(fmtChar == 'c' || strchr(legalPrintfTypeChars, fmtChar) != NULL, "printf: Type mismatch");
-	else
-		assertmsg(strchr(legalPrintfTypeChars, fmtChar) != NULL, "printf: Type mismatch");
-#endif
+		char* p = out;
+		*p++ = hex[lead];
+		if (precision > 0 || alt)
+			*p++ = '.';
+		for (int i = 0; i < precision; ++i, frac <<= 4)
+			*p++ = (i < 16) ? hex[(unsigned) (frac >> 60)] : '0';
+		*p++ = upper ? 'P' : 'p';
+		*p++ = (exp < 0) ? '-' : '+';
+		p += Decimal(p, (exp < 0) ? 0 - (UINT64) exp : (UINT64) exp);
+		return p - out;
+	}
 
-	// allocate buffer for result
-	if (fmtChar == 's')
+	// Splits a double into the arguments of HexFloat().  Returns false if it
+	// is an infinity or a NaN, and then 'frac' is nonzero only for a NaN.
+	static bool SplitDouble(double d, bool& negative, unsigned& lead, UINT64& frac, int& fracBits, int& exp)
 	{
-		int len;
-
-		va_start(vl, sizeAndType);
-
-		if (sizeChar == 'h')
+		UINT64 bits;
+		memcpy(&bits, &d, sizeof(bits));
+		negative = (bits >> 63) != 0;
+		int biased = (int) ((bits >> 52) & 0x7FF);
+		frac = bits << 12;
+		fracBits = 52;
+		lead = 0;
+		exp = 0;
+
+		if (biased == 0x7FF)
+			return false;			// frac is 0 for an infinity
+		if (biased == 0)
 		{
-			char* staticStr = va_arg(vl, char*);
-			len = strlen(staticStr);
+			lead = 0;				// zero or subnormal
+			exp = (frac == 0) ? 0 : -1022;
 		}
 		else
 		{
-			assert(sizeChar == 'l');
-			wchar_t* staticStr = va_arg(vl, wchar_t*);
-			len = wcslen(staticStr);
+			lead = 1;
+			exp = biased - 1023;
 		}
+		return true;
+	}
 
-		if (len > width)
-			width = len;
-
-		va_end(vl);
+	// The same for a long double.  x87 extended precision has an explicit
+	// integer bit, and like glibc we show the top four bits of the
+	// significand before the point.  Other long double formats (except
+	// those that are the same as double) aren't handled, and 'fracBits' is
+	// set to 0 for them.
+	static bool SplitLongDouble(long double ld, bool& negative, unsigned& lead, UINT64& frac, int& fracBits, int& exp)
+	{
+	#if LDBL_MANT_DIG == 53
+		return SplitDouble((double) ld, negative, lead, frac, fracBits, exp);
+	#elif LDBL_MANT_DIG == 64
+		unsigned char bytes[sizeof(long double)];
+		memcpy(bytes, &ld, sizeof(bytes));
+		UINT64 significand;
+		memcpy(&significand, bytes, 8);
+		unsigned signExp = bytes[8] | (bytes[9] << 8);
+		negative = (signExp & 0x8000) != 0;
+		int biased = (int) (signExp & 0x7FFF);
+		fracBits = 60;
+
+		if (biased == 0x7FFF)
+		{
+			lead = 0;
+			exp = 0;
+			frac = significand << 1;	// 0 for an infinity
+			return false;
+		}
+		lead = (unsigned) (significand >> 60);
+		frac = significand << 4;
+		if (significand == 0)
+			exp = 0;
+		else
+			exp = ((biased == 0) ? 1 : biased) - 16383 - 3;
+		return true;
+	#else
+		(void) ld; (void) negative; (void) lead; (void) frac; (void) exp;
+		fracBits = 0;
+		return false;
+	#endif
 	}
 
-	if (precision > width)
-		width = precision;
-	width += 30;
-	result = (CharT*) alloca(width * sizeof(CharT));
+	// number of decimal digits in v, which must be less than 10^8
+	static size_t Count8(unsigned v)
+	{
+		size_t n = 1;
+		while (n < 8 && v >= Pow10(n))
+			++n;
+		return n;
+	}
 
-	va_start(vl, sizeAndType);
-	my_vsprintf(result, width, format, vl);
-	va_end(vl);
+	static unsigned Pow10(size_t n)
+	{
+		static const unsigned pow10[] = { 1, 10, 100, 1000, 10000, 100000,
+			1000000, 10000000, 100000000 };
+		return pow10[n];
+	}
 
-	_ostm << result;
+	static const char* Pairs()
+	{
+		static const char pairs[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		return pairs;
+	}
 
-	OutputStaticText();
-}
+#ifdef STREAMPRINTF_SSE2
+	// Returns the eight decimal digits of v (v < 10^8) as eight 16-bit lanes,
+	// most significant digit first.  This is Wojciech Mula's division-free
+	// method: split into two 4-digit halves, then get all eight digits with
+	// one multiply-high by reciprocal powers of ten.
+	static __m128i Digits8(unsigned v)
+	{
+		const __m128i div10000  = _mm_set1_epi32((int) 0xd1b71759);
+		const __m128i mul10000  = _mm_set1_epi32(10000);
+		const __m128i divPowers = _mm_set_epi16(-32768, 13108, 5243, 8389, -32768, 13108, 5243, 8389);
+		const __m128i shPowers  = _mm_set_epi16(-32768, 1 << 13, 1 << 11, 1 << 7, -32768, 1 << 13, 1 << 11, 1 << 7);
+		const __m128i mul10     = _mm_set1_epi16(10);
+
+		__m128i abcdefgh = _mm_cvtsi32_si128((int) v);
+		__m128i abcd = _mm_srli_epi64(_mm_mul_epu32(abcdefgh, div10000), 45);
+		__m128i efgh = _mm_sub_epi32(abcdefgh, _mm_mul_epu32(abcd, mul10000));
+		__m128i v1 = _mm_slli_epi64(_mm_unpacklo_epi16(abcd, efgh), 2);
+		__m128i v2 = _mm_unpacklo_epi16(v1, v1);
+		v2 = _mm_unpacklo_epi32(v2, v2);
+		__m128i v4 = _mm_mulhi_epu16(_mm_mulhi_epu16(v2, divPowers), shPowers);
+		__m128i v6 = _mm_slli_epi64(_mm_mullo_epi16(v4, mul10), 16);
+		return _mm_sub_epi16(v4, v6);
+	}
 
-//-----------------------------------------------------------------------------
-template <class CharT>
-void Printf<CharT>::OutputStaticText()
-{
-	CharT c[2] = { 0, 0 };
+	// Stores the eight digits of v, dropping the first 'skip' of them.
+	static size_t Store8(char* out, unsigned v, size_t skip)
+	{
+		__m128i ascii = _mm_add_epi8(_mm_packus_epi16(Digits8(v), _mm_setzero_si128()),
+									 _mm_set1_epi8('0'));
+		char tmp[16];
+		_mm_storeu_si128((__m128i*) tmp, ascii);
+		memcpy(out, tmp + skip, 8);
+		return 8 - skip;
+	}
 
-	while (_fmt[_pos] != '\0')
+	static size_t DecimalSSE2(char* out, UINT64 u)
 	{
-		if (_fmt[_pos] == '%')
+		if (u < 100)
 		{
-			assertmsg(_fmt[_pos+1] != '\0', "printf: Invalid format specification");
-			if (_fmt[_pos+1] == '%')	// in a printf format string, "%%" outputs "%"
-			{
-				// must output "%", not '%', so that it works properly for wchar_t
-				_ostm << "%";
-				++_pos;
-			}
-			else
+			if (u < 10)
 			{
-				break;
+				*out = (char) ('0' + (unsigned) u);
+				return 1;
 			}
+			memcpy(out, Pairs() + (unsigned) u * 2, 2);
+			return 2;
+		}
+		if (u < 100000000)
+			return Store8(out, (unsigned) u, 8 - Count8((unsigned) u));
+
+		size_t n;
+		UINT64 hi = u / 100000000;
+		unsigned lo = (unsigned) (u - hi * 100000000);
+		if (hi < 100000000)
+		{
+			n = Store8(out, (unsigned) hi, 8 - Count8((unsigned) hi));
 		}
 		else
 		{
-			// must output "c", not 'c', so that it works properly for wchar_t
-			c[0] = _fmt[_pos];
-			_ostm << c;
+			// 17 to 20 digits: the top one to four digits are done the slow way
+			unsigned top = (unsigned) (hi / 100000000);
+			n = DecimalScalar(out, top);
+			n += Store8(out + n, (unsigned) (hi - (UINT64) top * 100000000), 0);
 		}
-		++_pos;
+		return n + Store8(out + n, lo, 0);
 	}
-}
-
-
+#endif
+};
 
 //-----------------------------------------------------------------------------
-template <class CharT>
-inline void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt)
-{
-	Printf<CharT> p(ostm, fmt);
-}
+// PrintfIntTraits<T> tells the bulk routines whether T is an integer type
+// they can convert directly, whether it is signed, and how to split it into
+// sign and magnitude.
 
-template <class CharT, class A1>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1)
+template <class T>
+struct PrintfIntTraits
 {
-	Printf<CharT> p(ostm, fmt);
-	p << a1;
-}
+	enum { isInteger = false, isSigned = false };
+	static bool Negative(const T&)                      { return false; }
+	static PrintfDigits::UINT64 Magnitude(const T&)     { return 0; }
+};
 
-template <class CharT, class A1, class A2>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2;
-}
+#define STREAMPRINTF_INT_TRAITS(T, sign, negative, magnitude)            \
+	template <> struct PrintfIntTraits<T>                                \
+	{                                                                    \
+		enum { isInteger = true, isSigned = sign };                      \
+		static bool Negative(T n)                  { return negative; }  \
+		static PrintfDigits::UINT64 Magnitude(T n) { return magnitude; } \
+	};
+#define STREAMPRINTF_SIGNED_TRAITS(T) \
+	STREAMPRINTF_INT_TRAITS(T, true, n < 0, n < 0 ? 0 - (PrintfDigits::UINT64) n : (PrintfDigits::UINT64) n)
+#define STREAMPRINTF_UNSIGNED_TRAITS(T) \
+	STREAMPRINTF_INT_TRAITS(T, false, ((void) n, false), n)
+
+STREAMPRINTF_SIGNED_TRAITS(short)
+STREAMPRINTF_UNSIGNED_TRAITS(unsigned short)
+STREAMPRINTF_SIGNED_TRAITS(int)
+STREAMPRINTF_UNSIGNED_TRAITS(unsigned int)
+STREAMPRINTF_SIGNED_TRAITS(long)
+STREAMPRINTF_UNSIGNED_TRAITS(unsigned long)
+#ifdef _MSC_VER
+STREAMPRINTF_SIGNED_TRAITS(__int64)
+STREAMPRINTF_UNSIGNED_TRAITS(unsigned __int64)
+#else
+STREAMPRINTF_SIGNED_TRAITS(long long)
+STREAMPRINTF_UNSIGNED_TRAITS(unsigned long long)
+#endif
 
-template <class CharT, class A1, class A2, class A3>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3;
-}
+#undef STREAMPRINTF_SIGNED_TRAITS
+#undef STREAMPRINTF_UNSIGNED_TRAITS
+#undef STREAMPRINTF_INT_TRAITS
 
-template <class CharT, class A1, class A2, class A3, class A4>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4)
+//-----------------------------------------------------------------------------
+template <class CharT>
+void PrintfOstreamSink<CharT>::Write(const CharT* s, size_t len)
 {
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4;
+	_ostm->write(s, len);
 }
 
-template <class CharT, class A1, class A2, class A3, class A4, class A5>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4 << a5;
-}
+//-----------------------------------------------------------------------------
+// Collects output in a large buffer and writes it to the stream in blocks of
+// 'bufferSize' characters; a write larger than that isn't copied, but goes
+// to the stream as it is.  Whatever is left is written by Flush() or by the
+// destructor.
 
-template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
+template <class CharT>
+class PrintfBufferedSink: public PrintfSink<CharT>
 {
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4 << a5 << a6;
-}
+public:
+	enum { DefaultBufferSize = 64 * 1024 };
 
-template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4 << a5 << a6 << a7;
-}
+	PrintfBufferedSink(std::basic_ostream<CharT>& ostm, size_t bufferSize = DefaultBufferSize)
+		: _ostm(ostm), _buf(new CharT[bufferSize]), _size(bufferSize), _len(0) {}
+	virtual ~PrintfBufferedSink()
+		{ Flush(); delete[] _buf; }
 
-template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8;
-}
+	virtual void Write(const CharT* s, size_t len)
+	{
+		// what wouldn't fit in the buffer even if it were empty goes straight
+		// to the stream, after what has been buffered so far
+		if (len >= _size)
+		{
+			Flush();
+			_ostm.write(s, len);
+			return;
+		}
 
-template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8 << a9;
-}
+		while (len > _size - _len)
+		{
+			size_t n = _size - _len;
+			memcpy(_buf + _len, s, n * sizeof(CharT));
+			_len += n;
+			s += n;
+			len -= n;
+			Flush();
+		}
+		memcpy(_buf + _len, s, len * sizeof(CharT));
+		_len += len;
+	}
 
-template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
-void oprintf(std::basic_ostream<CharT>& ostm, const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
-{
-	Printf<CharT> p(ostm, fmt);
-	p << a1 << a2 << a3 << a4 << a5 << a6 << a7 << a8 << a9 << a10;
-}
+	void Put(CharT c)
+	{
+		if (_len == _size)
+			Flush();
+		_buf[_len++] = c;
+	}
+
+	void Flush()
+	{
+		_ostm.write(_buf, _len);
+		_len = 0;
+	}
 
+private:
+	PrintfBufferedSink(const PrintfBufferedSink&);
+	PrintfBufferedSink& operator=(const PrintfBufferedSink&);
 
+	std::basic_ostream<CharT>& _ostm;
+	CharT* _buf;
+	size_t _size;
+	size_t _len;
+};
 
 //-----------------------------------------------------------------------------
-template <class CharT>
-class strprintfT: public std::basic_string<CharT>
-{
-	typedef std::basic_string<CharT> Base;
+// A scratch array of T: on the stack if it need not be longer than N, and on
+// the heap otherwise, so that no width, precision or argument is ever able to
+// overflow the stack.  Reset() discards the contents.
 
+template <class T, size_t N>
+class PrintfBuffer
+{
 public:
-	strprintfT(const CharT* fmt)
-	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt);
-		*(Base*)this = o.str();
-	}
+	explicit PrintfBuffer(size_t size) : _p(_local) { Reset(size); }
+	~PrintfBuffer() { Release(); }
 
-	template <class A1>
-	strprintfT(const CharT* fmt, A1 a1)
+	void Reset(size_t size)
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1);
-		*(Base*)this = o.str();
+		Release();
+		_p = (size <= N) ? _local : new T[size];
 	}
 
-	template <class A1, class A2>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2)
+	T* Get() { return _p; }
+
+private:
+	PrintfBuffer(const PrintfBuffer&);
+	PrintfBuffer& operator=(const PrintfBuffer&);
+
+	void Release()
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2);
-		*(Base*)this = o.str();
+		if (_p != _local)
+			delete[] _p;
+		_p = _local;
 	}
 
-	template <class A1, class A2, class A3>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3)
+	T* _p;
+	T _local[N];
+};
+
+//-----------------------------------------------------------------------------
+// Locale-free conversion between the Unicode encodings, used when a string is
+// written to output of another character width.  Strings of 1-byte characters
+// are UTF-8, of 2-byte characters UTF-16, and of 4-byte characters UTF-32,
+// whatever the character type.  Anything that isn't valid (a bad UTF-8
+// sequence, an unpaired surrogate, a value above U+10FFFF) becomes U+FFFD.
+//
+// Runs of ASCII, the common case, are converted 16 characters at a time with
+// SSE2.
+
+class PrintfUtf
+{
+public:
+	enum { Replacement = 0xFFFD };
+
+	// Returns the length of s, but no more than 'max'.
+	template <class T>
+	static size_t Length(const T* s, size_t max)
+	{
+		size_t n = 0;
+		while (n < max && s[n] != 0)
+			++n;
+		return n;
+	}
+
+	static size_t Length(const char* s, size_t max)
+	{
+		if (max == (size_t) -1)
+			return strlen(s);
+		const void* nul = memchr(s, 0, max);	// which stops at the first NUL
+		return nul ? (const char*) nul - s : max;
+	}
+	static size_t Length(const wchar_t* s, size_t max)
+		{ return (max == (size_t) -1) ? wcslen(s) : Length<wchar_t>(s, max); }
+
+	// Writes s[0..len) to 'out', stopping before more than 'max' characters
+	// would be written, and returns the number written.  If 'out' is NULL, it
+	// only counts them.  A string of the same width is copied as it is.
+	template <class OutT, class InT>
+	static size_t Transcode(OutT* out, const InT* s, size_t len, size_t max)
+	{
+		if (sizeof(OutT) == sizeof(InT))
+		{
+			size_t n = (len < max) ? len : max;
+			if (out)
+				memcpy(out, s, n * sizeof(OutT));
+			return n;
+		}
+
+		size_t n = 0;
+		size_t i = 0;
+		while (i < len && n < max)
+		{
+			size_t run = (len - i < max - n) ? len - i : max - n;
+			run = CopyAscii(out ? out + n : NULL, s + i, run);
+			i += run;
+			n += run;
+			if (i == len || n == max)
+				break;
+
+			OutT units[4];
+			size_t k = Encode(units, Decode(s, len, i));
+			if (n + k > max)
+				break;
+			if (out)
+				memcpy(out + n, units, k * sizeof(OutT));
+			n += k;
+		}
+		return n;
+	}
+
+	// Returns the code unit c as an unsigned number.
+	template <class T>
+	static unsigned Unit(T c)
+		{ return (unsigned) c & (sizeof(T) == 1 ? 0xFFu : sizeof(T) == 2 ? 0xFFFFu : 0xFFFFFFFFu); }
+
+	// Returns the code point that starts at s[i], and moves i past it.
+	template <class T>
+	static unsigned Decode(const T* s, size_t len, size_t& i)
+	{
+		unsigned c = Unit(s[i++]);
+
+		if (sizeof(T) == 4)
+			return (c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) ? (unsigned) Replacement : c;
+
+		if (sizeof(T) == 2)
+		{
+			if (c < 0xD800 || c >= 0xE000)
+				return c;
+			if (c < 0xDC00 && i < len && Unit(s[i]) >= 0xDC00 && Unit(s[i]) < 0xE000)
+				return 0x10000 + ((c - 0xD800) << 10) + (Unit(s[i++]) - 0xDC00);
+			return Replacement;
+		}
+
+		if (c < 0x80)
+			return c;
+		size_t extra;
+		unsigned min;
+		if (c >= 0xC2 && c < 0xE0)
+			extra = 1, c &= 0x1F, min = 0x80;
+		else if (c >= 0xE0 && c < 0xF0)
+			extra = 2, c &= 0x0F, min = 0x800;
+		else if (c >= 0xF0 && c < 0xF5)
+			extra = 3, c &= 0x07, min = 0x10000;
+		else
+			return Replacement;
+		for (; extra > 0; --extra)
+		{
+			if (i == len || (Unit(s[i]) & 0xC0) != 0x80)
+				return Replacement;
+			c = (c << 6) | (Unit(s[i++]) & 0x3F);
+		}
+		return (c < min || c > 0x10FFFF || (c >= 0xD800 && c < 0xE000)) ? (unsigned) Replacement : c;
+	}
+
+	// Writes the code point c to 'out' (room for 4) and returns how many code
+	// units that took.
+	template <class T>
+	static size_t Encode(T* out, unsigned c)
+	{
+		if (sizeof(T) == 4)
+		{
+			out[0] = (T) c;
+			return 1;
+		}
+
+		if (sizeof(T) == 2)
+		{
+			if (c < 0x10000)
+			{
+				out[0] = (T) c;
+				return 1;
+			}
+			c -= 0x10000;
+			out[0] = (T) (0xD800 + (c >> 10));
+			out[1] = (T) (0xDC00 + (c & 0x3FF));
+			return 2;
+		}
+
+		if (c < 0x80)
+		{
+			out[0] = (T) c;
+			return 1;
+		}
+		size_t n = (c < 0x800) ? 2 : (c < 0x10000) ? 3 : 4;
+		static const unsigned char lead[] = { 0, 0, 0xC0, 0xE0, 0xF0 };
+		for (size_t j = n - 1; j > 0; --j, c >>= 6)
+			out[j] = (T) (0x80 | (c & 0x3F));
+		out[0] = (T) (lead[n] | c);
+		return n;
+	}
+
+	// Copies the ASCII characters at the start of s[0..len) to 'out' (if it
+	// isn't NULL), and returns how many there were.
+	template <class OutT, class InT>
+	static size_t CopyAscii(OutT* out, const InT* s, size_t len)
+	{
+		size_t i = 0;
+#ifdef STREAMPRINTF_SSE2
+		if (sizeof(InT) == 1)
+			i = WidenAscii(out, sizeof(OutT), (const char*) s, len);
+		else if (sizeof(OutT) == 1)
+			i = NarrowAscii((char*) out, s, sizeof(InT), len);
+#endif
+		for (; i < len && Unit(s[i]) < 0x80; ++i)
+		{
+			if (out)
+				out[i] = (OutT) s[i];
+		}
+		return i;
+	}
+
+#ifdef STREAMPRINTF_SSE2
+	// The 16-at-a-time part of CopyAscii() for UTF-8 to UTF-16 or UTF-32;
+	// stops at the first block that isn't all ASCII.
+	static size_t WidenAscii(void* out, size_t outSize, const char* s, size_t len)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+
+		for (; i + 16 <= len; i += 16)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+			if (_mm_movemask_epi8(v) != 0)
+				break;
+			if (!out)
+				continue;
+
+			__m128i lo = _mm_unpacklo_epi8(v, zero);
+			__m128i hi = _mm_unpackhi_epi8(v, zero);
+			if (outSize == 2)
+			{
+				__m128i* o = (__m128i*) ((char*) out + i * 2);
+				_mm_storeu_si128(o, lo);
+				_mm_storeu_si128(o + 1, hi);
+			}
+			else
+			{
+				__m128i* o = (__m128i*) ((char*) out + i * 4);
+				_mm_storeu_si128(o, _mm_unpacklo_epi16(lo, zero));
+				_mm_storeu_si128(o + 1, _mm_unpackhi_epi16(lo, zero));
+				_mm_storeu_si128(o + 2, _mm_unpacklo_epi16(hi, zero));
+				_mm_storeu_si128(o + 3, _mm_unpackhi_epi16(hi, zero));
+			}
+		}
+		return i;
+	}
+
+	// The same for UTF-16 or UTF-32 to UTF-8.
+	static size_t NarrowAscii(char* out, const void* s, size_t inSize, size_t len)
+	{
+		const __m128i zero = _mm_setzero_si128();
+		size_t i = 0;
+
+		for (; i + 16 <= len; i += 16)
+		{
+			__m128i v;
+			if (inSize == 2)
+			{
+				const __m128i* p = (const __m128i*) ((const char*) s + i * 2);
+				__m128i a = _mm_loadu_si128(p);
+				__m128i b = _mm_loadu_si128(p + 1);
+				__m128i high = _mm_and_si128(_mm_or_si128(a, b), _mm_set1_epi16((short) 0xFF80));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi16(high, zero)) != 0xFFFF)
+					break;
+				v = _mm_packus_epi16(a, b);
+			}
+			else
+			{
+				const __m128i* p = (const __m128i*) ((const char*) s + i * 4);
+				__m128i a = _mm_loadu_si128(p);
+				__m128i b = _mm_loadu_si128(p + 1);
+				__m128i c = _mm_loadu_si128(p + 2);
+				__m128i d = _mm_loadu_si128(p + 3);
+				__m128i high = _mm_and_si128(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d)),
+											 _mm_set1_epi32((int) 0xFFFFFF80));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi32(high, zero)) != 0xFFFF)
+					break;
+				v = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+			}
+			if (out)
+				_mm_storeu_si128((__m128i*) (out + i), v);
+		}
+		return i;
+	}
+#endif
+};
+
+//-----------------------------------------------------------------------------
+// PrintfTranscode() writes the NUL-terminated string s to 'out' as characters
+// of out's type, stopping before more than 'max' of them would be written, and
+// returns the number written; if 'out' is NULL it only counts them.  That is
+// how "%s" and "%ls" write a narrow string to wide output and vice versa.
+
+template <class OutT, class InT>
+inline size_t PrintfTranscode(OutT* out, const InT* s, size_t max)
+{
+	// each output character takes at most four input characters
+	size_t maxIn = (sizeof(OutT) == sizeof(InT) || max > (size_t) -1 / 4) ? max : max * 4;
+	return PrintfUtf::Transcode(out, s, PrintfUtf::Length(s, maxIn), max);
+}
+
+//-----------------------------------------------------------------------------
+// With STREAMPRINTF_C_LOCALE, a PrintfCLocale makes the C runtime's formatting
+// functions use the "C" locale, on this thread only, for as long as it
+// exists.  With Visual C++ (2005 and later) the "_l" functions are given
+// Get() instead.
+
+#ifdef STREAMPRINTF_C_LOCALE
+class PrintfCLocale
+{
+public:
+#ifdef _MSC_VER
+	static _locale_t Get()
+		{ static _locale_t c = _create_locale(LC_ALL, "C"); return c; }
+#else
+	PrintfCLocale() : _old(uselocale(Get())) {}
+	~PrintfCLocale() { uselocale(_old); }
+
+	static locale_t Get()
+		{ static locale_t c = newlocale(LC_ALL_MASK, "C", (locale_t) 0); return c; }
+
+private:
+	PrintfCLocale(const PrintfCLocale&);
+	PrintfCLocale& operator=(const PrintfCLocale&);
+
+	locale_t _old;
+#endif
+};
+#endif
+
+//-----------------------------------------------------------------------------
+// Only floating-point numbers are formatted by the C runtime (everything else
+// is converted natively), and their text is plain ASCII, so it is always
+// formatted narrow, and widened as it's written.  Like C99's snprintf(), this
+// writes at most 'size' characters, including the NUL, and returns the length
+// of the whole text; the older Microsoft runtimes return -1 instead if it
+// doesn't fit.
+
+template <class CharT>
+int Printf<CharT>::my_snprintf(char* output, size_t size, const char* format, ...)
+{
+	va_list vl;
+	va_start(vl, format);
+#if defined(_MSC_VER) && defined(STREAMPRINTF_C_LOCALE)
+	int len = _vsnprintf_s_l(output, size, _TRUNCATE, format, PrintfCLocale::Get(), vl);
+#elif defined(_MSC_VER) && _MSC_VER < 1900
+	int len = _vsnprintf(output, size, format, vl);
+#else
+	#ifdef STREAMPRINTF_C_LOCALE
+		PrintfCLocale cLocale;
+	#endif
+	int len = vsnprintf(output, size, format, vl);
+#endif
+	va_end(vl);
+	return len;
+}
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+void Printf<CharT>::Do(int sizeAndType, ...)
+{
+	Size size = (Size) (sizeAndType & sizeMask);
+	Type type = (Type) (sizeAndType & typeMask);
+	va_list vl;
+	CharT sizeChar;
+	CharT fmtChar;
+	int flags = 0;
+	int width = 0;
+	int precision = 0;
+	bool hasPrecision = false;
+
+#ifndef NDEBUG
+	const char* legalPrintfTypeChars;
+#ifdef STREAMPRINTF_STRICT_SIGN
+	const char* legalPrintfIntChars = (type == Unsigned) ? "uoxXbB" : "dioxXbB";
+#else
+	const char* legalPrintfIntChars = "diuoxXbB";
+#endif
+
+	switch (type)
+	{
+	case Int:
+	case Unsigned:   legalPrintfTypeChars = legalPrintfIntChars; break;
+	case Float:      legalPrintfTypeChars = "eEfgGaA"; break;
+	case Char:       legalPrintfTypeChars = "c";     break;
+	case String:     legalPrintfTypeChars = "sp";    break;
+	case Pointer:    legalPrintfTypeChars = "p";     break;
+	case User:       legalPrintfTypeChars = "";      break;	// see below
+	default:         assert(false);
+	}
+#endif
+
+	assertmsg(_fmt[_pos] == '%', "printf: Too many arguments");
+
+	// A '*' width or precision takes its value from an argument of its own,
+	// which comes before the one being formatted.  Until all of them have
+	// arrived, each argument is saved as a '*' value, and the specification
+	// is processed again when the next argument comes in.
+	if (_numPositional == 0 && _numStars < CountStars(_pos))
+	{
+		assertmsg((type == Int || type == Unsigned) && size == None, "printf: Type mismatch");
+		va_start(vl, sizeAndType);
+		_starValues[_numStars++] = va_arg(vl, int);
+		va_end(vl);
+		return;
+	}
+
+	++_pos;
+
+	// "n$" of a positional specification; the argument has already been
+	// picked by OutputPositional()
+	if (_numPositional != 0)
+		_pos = ParsePosition(_pos) + 1;
+
+	// flags
+	static const char flagChars[] = "-+ #0'";	// in the order of the Flag bits
+	for (const char* flag; _fmt[_pos] != '\0' && (flag = FindChar(flagChars, _fmt[_pos])) != NULL; ++_pos)
+		flags |= 1 << (flag - flagChars);
+
+	// width
+	int star = 0;
+	if (_fmt[_pos] == '*')
+	{
+		width = StarValue(star++);
+		if (width < 0)
+		{
+			flags |= LeftJustify;	// a negative width means left-justify
+			width = -width;
+		}
+	}
+	else
+	{
+		while (IsDigit(_fmt[_pos]))
+			width = (width*10) + (_fmt[_pos++] - '0');
+	}
+
+	// precision
+	if (_fmt[_pos] == '.')
+	{
+		hasPrecision = true;
+		++_pos;
+		if (_fmt[_pos] == '*')
+		{
+			precision = StarValue(star++);
+			if (precision < 0)
+			{
+				precision = 0;	// a negative precision is as if it were omitted
+				hasPrecision = false;
+			}
+		}
+		else
+		{
+			while (IsDigit(_fmt[_pos]))
+				precision = (precision*10) + (_fmt[_pos++] - '0');
+		}
+	}
+	_numStars = 0;
+
+	// size: "hh" and "ll" are represented by 'H' and 'q'
+	if (_fmt[_pos] == 'h' || _fmt[_pos] == 'l')
+	{
+		sizeChar = _fmt[_pos++];
+		if (_fmt[_pos] == sizeChar)
+		{
+			++_pos;
+			sizeChar = (sizeChar == 'h') ? 'H' : 'q';
+		}
+	}
+	else if (FindChar("Lzjt", _fmt[_pos]) != NULL)
+	{
+		sizeChar = _fmt[_pos++];
+	}
+	else if (_fmt[_pos] == 'I' && _fmt[_pos+1] == '6' && _fmt[_pos+2] == '4')
+	{
+		sizeChar = _fmt[_pos];
+		_pos += 3;
+	}
+	else
+	{
+		sizeChar = '\0';
+	}
+
+	assertmsg(_fmt[_pos] != '\0', "printf: Invalid format specification");
+	fmtChar = _fmt[_pos++];
+
+	if (sizeChar == '\0')
+	{
+		switch (fmtChar)
+		{
+		case 'c':
+		case 's':
+			sizeChar = (sizeof(CharT) == sizeof(char)) ? 'h' : 'l';
+			break;
+		case 'C':
+		case 'S':
+			sizeChar = (sizeof(CharT) == sizeof(char)) ? 'l' : 'h';
+			break;
+		}
+	}
+
+	if (fmtChar == 'C')
+		fmtChar = 'c';
+	else if (fmtChar == 'S')
+		fmtChar = 's';
+
+	if (type == User)
+	{
+		va_start(vl, sizeAndType);
+		UserArg arg = va_arg(vl, UserArg);
+		va_end(vl);
+		assertmsg(FindChar(arg.conversions(), fmtChar) != NULL, "printf: Type mismatch");
+
+		PrintfSpec<CharT> spec;
+		spec.flags = flags;
+		spec.width = width;
+		spec.precision = hasPrecision ? precision : -1;
+		spec.conversion = fmtChar;
+		arg.format(_sink, spec, arg.object);
+
+		OutputStaticText();
+		return;
+	}
+
+#ifndef NDEBUG
+	// Do the type-checking.  Characters and strings are tricky.
+	if (type == String && fmtChar == 'p')
+	{
+		assertmsg(sizeChar == '\0', "printf: Invalid format specification");
+	}
+	else if (type == Unsigned && size == Short)
+	{
+		// unsigned short can either mean an unsigned short integer,
+		// or a wchar_t
+		if (fmtChar == 'c')	// wchar_t is intended, so width must be 'l'
+			assertmsg(sizeChar == 'l', "printf: Type mismatch");
+		else				// unsigned short is intended, so width must be 'h'
+			assertmsg(sizeChar == 'h', "printf: Type mismatch");
+	}
+	else if ((type == Char || type == String) && size >= Utf8)
+	{
+		// char8_t, char16_t and char32_t say what they are, so any "%c" or
+		// "%s" will do, whatever its width
+		assertmsg(sizeChar == 'h' || sizeChar == 'l', "printf: Type mismatch");
+	}
+	else if (type == Char && fmtChar != 'c')
+	{
+		// a char used as a small integer, e.g. "%hhu"
+		assertmsg(sizeChar == 'H', "printf: Type mismatch");
+	}
+	else if (type == Int || type == Unsigned)
+	{
+		assertmsg(IntSizeMatches(size, sizeChar), "printf: Type mismatch");
+	}
+	else if (type == Float)
+	{
+		// "%lf" is the same as "%f"; long double needs "%Lf"
+		if (size == Long)
+			assertmsg(sizeChar == 'L', "printf: Type mismatch");
+		else
+			assertmsg(sizeChar == '\0' || sizeChar == 'l', "printf: Type mismatch");
+	}
+	else
+	{
+		switch (size)
+		{
+		case None:
+			assertmsg(sizeChar == '\0', "printf: Type mismatch");
+			break;
+		case Short:
+			assertmsg(sizeChar == 'h', "printf: Type mismatch");
+			break;
+		case Long:
+			assertmsg(sizeChar == 'l', "printf: Type mismatch");
+			break;
+		default:
+			assert(false);
+		}
+	}
+
+	if (type == Unsigned && size == Short)
+		assertmsg(fmtChar == 'c' || FindChar(legalPrintfTypeChars, fmtChar) != NULL, "printf: Type mismatch");
+	else if (type == Char && sizeChar == 'H')
+		assertmsg(FindChar(legalPrintfIntChars, fmtChar) != NULL, "printf: Type mismatch");
+	else
+		assertmsg(FindChar(legalPrintfTypeChars, fmtChar) != NULL, "printf: Type mismatch");
+#endif
+
+	// Each conversion writes its text straight to the sink, padding and all,
+	// so the width never decides how much memory is needed.  A string's
+	// length (in output characters, which for a string of the other width
+	// isn't its own length) is found first.
+	va_start(vl, sizeAndType);
+	if (fmtChar == 's')
+	{
+		const void* str = va_arg(vl, const void*);
+		size_t len = TranscodeString(NULL, str, size, hasPrecision ? (size_t) precision : (size_t) -1);
+		FormatString(_sink, str, size, len, flags, width);
+	}
+	else if (fmtChar == 'c')
+	{
+		// an unsigned short with "%lc" is a wchar_t (see above)
+		FormatChar(_sink, va_arg(vl, int), (type == Char) ? size : Long, flags, width);
+	}
+	else if (fmtChar == 'p')
+	{
+		FormatPointer(_sink, va_arg(vl, const void*), flags, width, hasPrecision ? precision : -1);
+	}
+	else if ((type == Int || type == Unsigned || type == Char) && FindChar("diouxXbB", fmtChar) != NULL)
+	{
+		// Integers are converted here rather than by vsprintf(), so that the
+		// value printed is always that of the argument itself, whatever its
+		// size and whatever size the specification names.  As in C, the
+		// signed conversions see the bits of the argument as signed, and the
+		// others see them as unsigned.
+		INT64 n;
+		UINT64 u;
+		bool isSigned = (fmtChar == 'd' || fmtChar == 'i');
+
+		if (size == Int64)
+		{
+			n = va_arg(vl, INT64);
+			u = (UINT64) n;
+		}
+		else if (size == Long)
+		{
+			n = (type == Unsigned) ? (INT64) va_arg(vl, unsigned long) : (INT64) va_arg(vl, long);
+			u = isSigned ? (UINT64) (long) n : (UINT64) (unsigned long) n;
+		}
+		else
+		{
+			n = va_arg(vl, int);	// anything smaller than an int was promoted
+			if (type == Char)
+				u = isSigned ? (UINT64) (signed char) n : (UINT64) (unsigned char) n;
+			else if (size == Short)
+				u = isSigned ? (UINT64) (short) n : (UINT64) (unsigned short) n;
+			else
+				u = isSigned ? (UINT64) (int) n : (UINT64) (unsigned) n;
+		}
+
+		bool negative = isSigned && (INT64) u < 0;
+		if (negative)
+			u = 0 - u;
+		FormatInteger(_sink, u, negative, fmtChar, flags, width, hasPrecision ? precision : -1);
+	}
+	else if (type == Float && (fmtChar == 'a' || fmtChar == 'A'))
+	{
+		bool negative;
+		unsigned lead;
+		UINT64 frac;
+		int fracBits, exp;
+		bool finite;
+
+		if (size == Long)
+			finite = PrintfDigits::SplitLongDouble(va_arg(vl, long double), negative, lead, frac, fracBits, exp);
+		else
+			finite = PrintfDigits::SplitDouble(va_arg(vl, double), negative, lead, frac, fracBits, exp);
+
+		if (fracBits == 0)
+		{
+			// a long double format we don't know
+			va_end(vl);
+			va_start(vl, sizeAndType);
+			FormatFloat(_sink, size, fmtChar, flags, width, hasPrecision ? precision : -1, vl);
+		}
+		else
+		{
+			FormatHexFloat(_sink, finite, negative, lead, frac, fracBits, exp,
+						   fmtChar, flags, width, hasPrecision ? precision : -1);
+		}
+	}
+	else
+	{
+		FormatFloat(_sink, size, fmtChar, flags, width, hasPrecision ? precision : -1, vl);
+	}
+	va_end(vl);
+
+	OutputStaticText();
+}
+
+//-----------------------------------------------------------------------------
+template <class CharT>
+void Printf<CharT>::OutputStaticText()
+{
+	size_t start = _pos;
+
+	while (_fmt[_pos] != '\0')
+	{
+		if (_fmt[_pos] == '%')
+		{
+			assertmsg(_fmt[_pos+1] != '\0', "printf: Invalid format specification");
+			if (_fmt[_pos+1] != '%')
+				break;
+
+			// in a printf format string, "%%" outputs "%": write the text up to
+			// and including the first '%', and skip the second
+			_sink.WriteInPlace(_fmt + start, _pos + 1 - start);
+			_pos += 2;
+			start = _pos;
+		}
+		else
+		{
+			++_pos;
+		}
+	}
+
+	if (_pos > start)
+		_sink.WriteInPlace(_fmt + start, _pos - start);
+}
+
+
+//-----------------------------------------------------------------------------
+// Whether an integer argument of the given size may be written with the given
+// size modifier.  Since integers are converted natively, the value written is
+// always the argument's own, so by default any of the int, long and long long
+// modifiers is accepted for any of those types.  With
+// STREAMPRINTF_STRICT_INTSIZE the modifier must name the argument's type, or
+// (for size_t, intmax_t and ptrdiff_t, which are typedefs of one of those
+// types) a type of the same size.
+
+template <class CharT>
+bool Printf<CharT>::IntSizeMatches(Size size, CharT sizeChar)
+{
+	size_t modifierBytes;
+
+	switch (sizeChar)
+	{
+	case '\0': modifierBytes = sizeof(int);       break;
+	case 'l':  modifierBytes = sizeof(long);      break;
+	case 'q':
+	case 'L':
+	case 'I':
+	case 'j':  modifierBytes = sizeof(INT64);     break;
+	case 'z':  modifierBytes = sizeof(size_t);    break;
+	case 't':  modifierBytes = sizeof(ptrdiff_t); break;
+	default:   return size == Short && sizeChar == 'h';
+	}
+
+	if (size == Short)
+		return false;
+
+#ifdef STREAMPRINTF_STRICT_INTSIZE
+	switch (sizeChar)
+	{
+	case '\0': return size == None;
+	case 'l':  return size == Long;
+	case 'q':
+	case 'L':
+	case 'I':  return size == Int64;
+	}
+
+	size_t argBytes = (size == None) ? sizeof(int) : (size == Long) ? sizeof(long) : sizeof(INT64);
+	return modifierBytes == argBytes;
+#else
+	(void) modifierBytes;
+	return true;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Writes the text of an integer conversion ('conv' is one of "diouxXbB") of
+// the value whose magnitude is u.  'precision' is -1 if the specification has
+// none.
+
+template <class CharT>
+void Printf<CharT>::FormatInteger(PrintfSink<CharT>& sink, UINT64 u, bool negative, CharT conv,
+								  int flags, int width, int precision)
+{
+	char digits[PrintfDigits::MaxDigits + PrintfDigits::Slack];
+	size_t numDigits;
+
+	if (conv == 'o')
+		numDigits = PrintfDigits::Radix(digits, u, 3, false);
+	else if (conv == 'x' || conv == 'X')
+		numDigits = PrintfDigits::Radix(digits, u, 4, conv == 'X');
+	else if (conv == 'b' || conv == 'B')
+		numDigits = PrintfDigits::Binary(digits, u);
+	else
+		numDigits = PrintfDigits::Decimal(digits, u);
+	if (precision == 0 && u == 0)
+		numDigits = 0;			// "%.0d" of 0 is nothing at all
+
+	char prefix[2];
+	size_t prefixLen = 0;
+	if (conv == 'd' || conv == 'i')
+	{
+		if (negative)
+			prefix[prefixLen++] = '-';
+		else if (flags & ForceSign)
+			prefix[prefixLen++] = '+';
+		else if (flags & SpaceSign)
+			prefix[prefixLen++] = ' ';
+	}
+	else if ((flags & Alternate) && conv != 'o' && conv != 'u' && u != 0)
+	{
+		prefix[prefixLen++] = '0';	// "0x", "0X", "0b" or "0B"
+		prefix[prefixLen++] = (char) conv;
+	}
+
+	size_t zeros = (precision > (int) numDigits) ? precision - numDigits : 0;
+	if ((flags & Alternate) && conv == 'o' && zeros == 0 && (numDigits == 0 || digits[0] != '0'))
+		zeros = 1;				// "%#o" always starts with a 0
+
+	// the '0' flag is ignored when there is a precision
+	if (precision >= 0)
+		flags &= ~ZeroPad;
+
+	if ((flags & Grouping) && (conv == 'd' || conv == 'i' || conv == 'u'))
+	{
+		// the zeros that make up the precision are grouped too
+		PrintfBuffer<char, 128> padded(zeros + numDigits);
+		memset(padded.Get(), '0', zeros);
+		memcpy(padded.Get() + zeros, digits, numDigits);
+		numDigits += zeros;
+
+		PrintfBuffer<CharT, 128> grouped(numDigits * (1 + MaxGroupSeparator));
+		size_t groupedLen = Group(grouped.Get(), padded.Get(), numDigits);
+		Justify(sink, prefix, prefixLen, 0, grouped.Get(), groupedLen, flags, width);
+		return;
+	}
+	Justify(sink, prefix, prefixLen, zeros, digits, numDigits, flags, width);
+}
+
+//-----------------------------------------------------------------------------
+// Writes the text of a "%a" or "%A" conversion, given the number split up by
+// PrintfDigits::SplitDouble() or SplitLongDouble().
+
+template <class CharT>
+void Printf<CharT>::FormatHexFloat(PrintfSink<CharT>& sink, bool finite, bool negative, unsigned lead, UINT64 frac,
+								   int fracBits, int exp, CharT conv, int flags, int width, int precision)
+{
+	bool upper = (conv == 'A');
+	char prefix[3];
+	size_t prefixLen = 0;
+
+	if (negative)
+		prefix[prefixLen++] = '-';
+	else if (flags & ForceSign)
+		prefix[prefixLen++] = '+';
+	else if (flags & SpaceSign)
+		prefix[prefixLen++] = ' ';
+
+	if (!finite)
+	{
+		const char* text = (frac != 0) ? (upper ? "NAN" : "nan") : (upper ? "INF" : "inf");
+		Justify(sink, prefix, prefixLen, 0, text, 3, flags & ~ZeroPad, width);
+		return;
+	}
+
+	prefix[prefixLen++] = '0';
+	prefix[prefixLen++] = upper ? 'X' : 'x';
+
+	PrintfBuffer<char, 128> body((precision > 0 ? precision : 0) + 40);
+	size_t bodyLen = PrintfDigits::HexFloat(body.Get(), lead, frac, fracBits, exp, precision,
+											(flags & Alternate) != 0, upper);
+	Justify(sink, prefix, prefixLen, 0, body.Get(), bodyLen, flags, width);
+}
+
+//-----------------------------------------------------------------------------
+// Writes prefix (a sign or "0x"), then 'zeros' zeros, then body, padded out
+// to 'width' on the left or right, with zeros after the prefix if the
+// ZeroPad flag is set.  A field of up to PrintfFillChunk characters is put
+// together here and written in one piece; a wider one is written a piece at
+// a time, with the padding and the zeros filled in by PrintfWriteFill().
+
+template <class CharT>
+template <class BodyT>
+void Printf<CharT>::Justify(PrintfSink<CharT>& sink, const char* prefix, size_t prefixLen, size_t zeros,
+							const BodyT* body, size_t bodyLen, int flags, int width)
+{
+	size_t len = prefixLen + zeros + bodyLen;
+	size_t pad = ((size_t) width > len) ? width - len : 0;
+	size_t total = len + pad;
+	if ((flags & ZeroPad) && !(flags & LeftJustify))
+	{
+		zeros += pad;
+		pad = 0;
+	}
+
+	if (total <= (size_t) PrintfFillChunk)
+	{
+		CharT out[PrintfFillChunk];
+		CharT* p = out;
+		if (!(flags & LeftJustify))
+			for (; pad > 0; --pad)
+				*p++ = ' ';
+		for (size_t j = 0; j < prefixLen; ++j)
+			*p++ = prefix[j];
+		for (; zeros > 0; --zeros)
+			*p++ = '0';
+		for (size_t j = 0; j < bodyLen; ++j)
+			*p++ = body[j];
+		for (; pad > 0; --pad)
+			*p++ = ' ';
+		sink.WriteArg(out, p - out);
+		return;
+	}
+
+	if (!(flags & LeftJustify))
+		PrintfWriteFill(sink, (CharT) ' ', pad);
+	if (prefixLen > 0)
+		WriteBody(sink, prefix, prefixLen);
+	PrintfWriteFill(sink, (CharT) '0', zeros);
+	WriteBody(sink, body, bodyLen);
+	if (flags & LeftJustify)
+		PrintfWriteFill(sink, (CharT) ' ', pad);
+}
+
+//-----------------------------------------------------------------------------
+// Writes body, whose characters are ASCII of another type than CharT, to the
+// sink a chunk at a time.
+
+template <class CharT>
+template <class BodyT>
+void Printf<CharT>::WriteBody(PrintfSink<CharT>& sink, const BodyT* body, size_t len)
+{
+	CharT chunk[PrintfFillChunk];
+	while (len > 0)
+	{
+		size_t n = (len < (size_t) PrintfFillChunk) ? len : (size_t) PrintfFillChunk;
+		for (size_t j = 0; j < n; ++j)
+			chunk[j] = body[j];
+		sink.WriteArg(chunk, n);
+		body += n;
+		len -= n;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// PrintfTranscode() of the string str, whose characters are of the type that
+// 'strSize' stands for.
+
+template <class CharT>
+size_t Printf<CharT>::TranscodeString(CharT* out, const void* str, Size strSize, size_t max)
+{
+	switch (strSize)
+	{
+	case Long:  return PrintfTranscode(out, (const wchar_t*) str, max);
+#ifdef STREAMPRINTF_CHAR16
+	case Utf16: return PrintfTranscode(out, (const char16_t*) str, max);
+	case Utf32: return PrintfTranscode(out, (const char32_t*) str, max);
+#endif
+	default:    return PrintfTranscode(out, (const char*) str, max);	// char or char8_t
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Writes the text of a "%s" conversion: the first 'len' characters of str
+// (as counted by TranscodeString()), padded out to 'width'.  A string of the
+// output's own width is written from where it is, and with no padding it is
+// handed to the sink as it is, however long, without being copied; a string
+// of any other width is converted first.
+
+template <class CharT>
+void Printf<CharT>::FormatString(PrintfSink<CharT>& sink, const void* str, Size strSize, size_t len, int flags, int width)
+{
+	if (CharSize(strSize) == sizeof(CharT) && (size_t) width <= len)
+	{
+		sink.WriteArgInPlace((const CharT*) str, len);
+	}
+	else if (CharSize(strSize) == sizeof(CharT))
+	{
+		Justify(sink, "", 0, 0, (const CharT*) str, len, flags & ~ZeroPad, width);
+	}
+	else
+	{
+		PrintfBuffer<CharT, PrintfFillChunk> converted(len);
+		TranscodeString(converted.Get(), str, strSize, len);
+		Justify(sink, "", 0, 0, converted.Get(), len, flags & ~ZeroPad, width);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Writes the text of a "%c" conversion of c, a character of the type that
+// 'charSize' stands for.
+
+template <class CharT>
+void Printf<CharT>::FormatChar(PrintfSink<CharT>& sink, int c, Size charSize, int flags, int width)
+{
+	size_t unitSize = CharSize(charSize);
+	CharT units[4];
+	size_t len;
+
+	if (c == 0 || unitSize == sizeof(CharT))
+	{
+		// no conversion; "%c" of '\0' writes a NUL
+		units[0] = (CharT) c;
+		len = 1;
+	}
+	else
+	{
+		// a lone UTF-8 byte or UTF-16 unit is a whole character only if it
+		// is ASCII or not a surrogate, respectively
+		unsigned u = (unsigned) c & (unitSize == 1 ? 0xFFu : unitSize == 2 ? 0xFFFFu : 0xFFFFFFFFu);
+		bool valid = (unitSize == 1) ? u < 0x80 : (u < 0xD800 || (u >= 0xE000 && u <= 0x10FFFF));
+		len = PrintfUtf::Encode(units, valid ? u : (unsigned) PrintfUtf::Replacement);
+	}
+	Justify(sink, "", 0, 0, units, len, flags & ~ZeroPad, width);
+}
+
+//-----------------------------------------------------------------------------
+// Writes the text of a "%p" conversion, the way the C runtime does.
+
+template <class CharT>
+void Printf<CharT>::FormatPointer(PrintfSink<CharT>& sink, const void* p, int flags, int width, int precision)
+{
+	UINT64 u = (UINT64) (size_t) p;
+#ifdef _MSC_VER
+	FormatInteger(sink, u, false, 'X', flags & ~Alternate, width, sizeof(void*) * 2);
+#else
+	if (p == NULL)
+		Justify(sink, "", 0, 0, "(nil)", 5, flags & ~ZeroPad, width);
+	else
+		FormatInteger(sink, u, false, 'x', flags | Alternate, width, precision);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// Writes digits to 'out' with the group separator between each group of
+// three, counting from the right, and returns the number of characters
+// written.
+
+template <class CharT>
+size_t Printf<CharT>::Group(CharT* out, const char* digits, size_t numDigits)
+{
+	const CharT* sep = GroupSeparator();
+	CharT* p = out;
+
+	for (size_t i = 0; i < numDigits; ++i)
+	{
+		if (i != 0 && (numDigits - i) % 3 == 0)
+		{
+			for (const CharT* s = sep; *s != '\0'; ++s)
+				*p++ = *s;
+		}
+		*p++ = digits[i];
+	}
+	return p - out;
+}
+
+//-----------------------------------------------------------------------------
+// "%e", "%f", "%g" and the like: the C runtime formats the number without
+// the width, into a buffer on the stack if the text fits, which it nearly
+// always does, or on the heap otherwise.  With the ' flag, the digits in front
+// of the decimal point of "%'f" or "%'g" are then grouped, and the result is
+// padded to the width here, like every other conversion.
+
+template <class CharT>
+void Printf<CharT>::FormatFloat(PrintfSink<CharT>& sink, Size size, CharT conv,
+								int flags, int width, int precision, va_list vl)
+{
+	char format[32];
+	int i = 0;
+
+	format[i++] = '%';
+	if (flags & ForceSign)
+		format[i++] = '+';
+	if (flags & SpaceSign)
+		format[i++] = ' ';
+	if (flags & Alternate)
+		format[i++] = '#';
+	if (precision >= 0)
+	{
+		format[i++] = '.';
+		i += AppendDecimal(format + i, precision);
+	}
+	if (size == Long)
+		format[i++] = 'L';
+	format[i++] = (char) conv;
+	format[i] = '\0';
+
+	long double ld = 0;
+	double d = 0;
+	if (size == Long)
+		ld = va_arg(vl, long double);
+	else
+		d = va_arg(vl, double);
+
+	size_t bufferSize = 512;
+	PrintfBuffer<char, 512> number(bufferSize);
+	int result;
+	while ((result = (size == Long) ? my_snprintf(number.Get(), bufferSize, format, ld)
+									: my_snprintf(number.Get(), bufferSize, format, d)) < 0
+		   || (size_t) result >= bufferSize)
+	{
+		bufferSize = (result < 0) ? bufferSize * 2 : (size_t) result + 1;
+		number.Reset(bufferSize);
+	}
+	const char* text = number.Get();
+	size_t len = result;
+
+	// the sign (and the "0x" of a "%a" that the C runtime formatted), then
+	// the digits, then the rest ('.', fraction, exponent)
+	size_t start = 0;
+	if (start < len && (text[start] == '-' || text[start] == '+' || text[start] == ' '))
+		++start;
+	if ((conv == 'a' || conv == 'A') && start + 1 < len && text[start] == '0'
+		&& (text[start+1] == 'x' || text[start+1] == 'X'))
+		start += 2;
+	size_t end = start;
+	while (end < len && text[end] >= '0' && text[end] <= '9')
+		++end;
+	if (end == start)
+		flags &= ~ZeroPad;	// inf or nan
+
+	if (!(flags & Grouping) || FindChar("fFgG", conv) == NULL)
+	{
+		Justify(sink, text, start, 0, text + start, len - start, flags, width);
+		return;
+	}
+
+	PrintfBuffer<CharT, 512> body((end - start) * (1 + MaxGroupSeparator) + len);
+	size_t bodyLen = Group(body.Get(), text + start, end - start);
+	for (size_t j = end; j < len; ++j)
+		body.Get()[bodyLen++] = text[j];
+
+	Justify(sink, text, start, 0, body.Get(), bodyLen, flags, width);
+}
+
+//-----------------------------------------------------------------------------
+// Returns the number of '*' widths and precisions in the format specification
+// that starts at 'pos' (the position of its '%').
+
+template <class CharT>
+int Printf<CharT>::CountStars(size_t pos) const
+{
+	int stars = 0;
+	for (++pos; FindChar("-+0 #'.*0123456789", _fmt[pos]) != NULL; ++pos)
+	{
+		if (_fmt[pos] == '*')
+			++stars;
+	}
+	return stars;
+}
+
+//-----------------------------------------------------------------------------
+// Called with _pos at a '*' in a format specification.  Skips past it (and
+// past its "m$" in a positional format) and returns its value, which is the
+// 'star'th of the '*' values saved for this specification, or, in a
+// positional format, argument m.
+
+template <class CharT>
+int Printf<CharT>::StarValue(int star)
+{
+	++_pos;
+	if (_numPositional == 0)
+		return _starValues[star];
+
+	size_t dollar = ParsePosition(_pos);
+	assertmsg(dollar != 0, "printf: Positional and non-positional specifications can't be mixed");
+
+	size_t n = 0;
+	for (; _pos < dollar; ++_pos)
+		n = n*10 + (_fmt[_pos] - '0');
+	++_pos;
+
+	const Arg& arg = _args[n - 1];
+	assertmsg(arg.sizeAndType == (None | Int) || arg.sizeAndType == (None | Unsigned), "printf: Type mismatch");
+	return arg.i;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the decimal digits of n to 'out' and returns how many there were.
+
+template <class CharT>
+int Printf<CharT>::AppendDecimal(char* out, int n)
+{
+	char digits[PrintfDigits::MaxDigits + PrintfDigits::Slack];
+	size_t len = PrintfDigits::Decimal(digits, (unsigned) n);
+	for (size_t j = 0; j < len; ++j)
+		out[j] = digits[j];
+	return (int) len;
+}
+
+//-----------------------------------------------------------------------------
+// If the format specification whose text starts at 'pos' (just after the '%')
+// begins with "n$", returns the position of the '$'; otherwise returns 0.
+
+template <class CharT>
+size_t Printf<CharT>::ParsePosition(size_t pos) const
+{
+	if (_fmt[pos] < '1' || _fmt[pos] > '9')
+		return 0;
+	while (IsDigit(_fmt[pos]))
+		++pos;
+	return (_fmt[pos] == '$') ? pos : 0;
+}
+
+//-----------------------------------------------------------------------------
+// Called once the static text in front of the first format specification has
+// been written.  If that specification is positional, walks the rest of the
+// format to build _argIndex, the map from each specification to the argument
+// it uses; the arguments are then captured as they arrive, and
+// OutputPositional() writes everything once the last one is in.
+//
+// _argIndex and _args have room for MaxPositional entries, so a format with
+// more specifications or a larger argument number than that is rejected even
+// when assertions are off (see RejectPositional()), as is one that would
+// index them with a missing "n$".
+
+template <class CharT>
+void Printf<CharT>::ScanPositional()
+{
+	if (_fmt[_pos] == '\0' || ParsePosition(_pos + 1) == 0)
+		return;
+
+#ifndef NDEBUG
+	bool used[MaxPositional] = { false };
+#endif
+	size_t numArgs = 0;
+
+	_numSpecs = 0;
+	_numCaptured = 0;
+	for (size_t pos = _pos; _fmt[pos] != '\0'; ++pos)
+	{
+		if (_fmt[pos] != '%')
+			continue;
+		if (_fmt[pos+1] == '%')
+		{
+			++pos;
+			continue;
+		}
+
+		size_t dollar = ParsePosition(pos + 1);
+		assertmsg(dollar != 0, "printf: Positional and non-positional specifications can't be mixed");
+		assertmsg(_numSpecs < MaxPositional, "printf: Too many format specifications");
+		if (dollar == 0 || _numSpecs >= MaxPositional)
+		{
+			RejectPositional();
+			return;
+		}
+
+		size_t n = 0;
+		for (size_t p = pos + 1; p < dollar && n <= MaxPositional; ++p)
+			n = n*10 + (_fmt[p] - '0');
+		assertmsg(n <= MaxPositional, "printf: Positional argument number is too large");
+		if (n > MaxPositional)
+		{
+			RejectPositional();
+			return;
+		}
+
+		_argIndex[_numSpecs++] = (unsigned char) (n - 1);
+#ifndef NDEBUG
+		used[n - 1] = true;
+#endif
+		if (n > numArgs)
+			numArgs = n;
+		pos = dollar;
+
+		// "*m$" widths and precisions use argument m
+		while (FindChar("-+0 #'.*0123456789", _fmt[pos+1]) != NULL)
+		{
+			if (_fmt[++pos] != '*')
+				continue;
+			dollar = ParsePosition(pos + 1);
+			assertmsg(dollar != 0, "printf: Positional and non-positional specifications can't be mixed");
+			for (n = 0; ++pos < dollar && n <= MaxPositional; )
+				n = n*10 + (_fmt[pos] - '0');
+			assertmsg(n <= MaxPositional, "printf: Positional argument number is too large");
+			if (dollar == 0 || n > MaxPositional)
+			{
+				RejectPositional();
+				return;
+			}
+			pos = dollar;
+#ifndef NDEBUG
+			used[n - 1] = true;
+#endif
+			if (n > numArgs)
+				numArgs = n;
+		}
+	}
+
+#ifndef NDEBUG
+	for (size_t n = 0; n < numArgs; ++n)
+		assertmsg(used[n], "printf: Positional argument is never used");
+#endif
+
+	_numPositional = numArgs;
+}
+
+//-----------------------------------------------------------------------------
+// Gives up on a positional format that ScanPositional() can't map: the rest
+// of it is written as it is, and the arguments are captured but never used.
+
+template <class CharT>
+void Printf<CharT>::RejectPositional()
+{
+	size_t start = _pos;
+	while (_fmt[_pos] != '\0')
+		++_pos;
+	_sink.WriteInPlace(_fmt + start, _pos - start);
+
+	_numSpecs = 0;
+	_numCaptured = 0;
+	_numPositional = MaxPositional;
+}
+
+//-----------------------------------------------------------------------------
+// Writes a positional format once all of its arguments have been captured.
+// Each Do() call converts one specification and writes the static text that
+// follows it, so the specifications are visited in format order.
+
+template <class CharT>
+void Printf<CharT>::OutputPositional()
+{
+	for (size_t spec = 0; spec < _numSpecs; ++spec)
+		DoArg(_args[_argIndex[spec]]);
+}
+
+//-----------------------------------------------------------------------------
+// Do() with a captured argument.
+
+template <class CharT>
+void Printf<CharT>::DoArg(const Arg& arg)
+{
+	int sizeAndType = arg.sizeAndType;
+
+	switch (arg.sizeAndType)
+	{
+	case Long | Int:       Do(sizeAndType, arg.l);   break;
+	case Int64 | Int:      Do(sizeAndType, arg.ll);  break;
+	case None | Unsigned:  Do(sizeAndType, arg.u);   break;
+	case Long | Unsigned:  Do(sizeAndType, arg.ul);  break;
+	case Int64 | Unsigned: Do(sizeAndType, arg.ull); break;
+	case None | Float:     Do(sizeAndType, arg.d);   break;
+	case Long | Float:     Do(sizeAndType, arg.ld);  break;
+	case Short | String:
+	case Long | String:
+	case Utf8 | String:
+	case Utf16 | String:
+	case Utf32 | String:
+	case None | Pointer:   Do(sizeAndType, arg.p);   break;
+	case None | User:      Do(sizeAndType, arg.user); break;
+	default:               Do(sizeAndType, arg.i);   break;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// Bulk output of an array of integers, each written with the same format:
+//      oprintf_array(std::cout, "%u\n", ids, count);
+//
+// The first element is written with oprintf(), so it is type-checked like any
+// other call.  If the format is just static text around a single plain "%d",
+// "%i" or "%u" (no flags, width or precision) whose signedness is that of the
+// elements, and whose size modifier, if it is "h" or "hh", names a type no
+// smaller than theirs, the remaining elements go through PrintfDigits into a
+// local buffer that is written to the stream in large blocks; otherwise each
+// element is written with oprintf(), so that they all come out alike.
+
+template <class CharT>
+class PrintfBulk
+{
+public:
+	PrintfBulk(const CharT* fmt)
+		: _prefix(fmt), _prefixLen(0), _suffix(0), _suffixLen(0), _signed(false), _maxBytes(0)
+	{
+		const CharT* p = fmt;
+		while (*p != '\0' && *p != '%')
+			++p;
+		_prefixLen = p - fmt;
+		if (*p++ != '%')
+			return;
+		if (*p == 'h')
+			_maxBytes = (p[1] == 'h') ? 1 : 2;
+		while (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'z' || *p == 'j' || *p == 't')
+			++p;
+		if (*p == 'I' && p[1] == '6' && p[2] == '4')
+			p += 3;
+		if (*p != 'd' && *p != 'i' && *p != 'u')
+			return;
+		_signed = (*p != 'u');
+		_suffix = ++p;
+		while (*p != '\0')
+		{
+			if (*p++ == '%')
+			{
+				_suffix = 0;
+				return;
+			}
+		}
+		_suffixLen = p - _suffix;
+	}
+
+	template <class T>
+	bool CanConvert() const
+	{
+		return PrintfIntTraits<T>::isInteger && _suffix != 0 && _prefixLen + _suffixLen + Reserve <= BufferSize
+			&& (PrintfIntTraits<T>::isSigned != 0) == _signed && (_maxBytes == 0 || sizeof(T) <= _maxBytes);
+	}
+
+	template <class T>
+	void Write(std::basic_ostream<CharT>& ostm, const T* values, size_t count)
+	{
+		CharT buf[BufferSize];
+		size_t n = 0;
+
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (n + _prefixLen + _suffixLen + Reserve > BufferSize)
+			{
+				ostm.write(buf, n);
+				n = 0;
+			}
+			n = Copy(buf, n, _prefix, _prefixLen);
+			if (PrintfIntTraits<T>::Negative(values[i]))
+				buf[n++] = '-';
+			n += Digits(buf + n, PrintfIntTraits<T>::Magnitude(values[i]));
+			n = Copy(buf, n, _suffix, _suffixLen);
+		}
+		ostm.write(buf, n);
+	}
+
+private:
+	enum { BufferSize = 4096, Reserve = 1 + PrintfDigits::MaxDigits + PrintfDigits::Slack };
+
+	static size_t Copy(CharT* buf, size_t n, const CharT* s, size_t len)
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3);
-		*(Base*)this = o.str();
+		memcpy(buf + n, s, len * sizeof(CharT));
+		return n + len;
 	}
 
-	template <class A1, class A2, class A3, class A4>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4)
+	static size_t Digits(CharT* out, PrintfDigits::UINT64 u);
+
+	const CharT* _prefix;
+	size_t _prefixLen;
+	const CharT* _suffix;	// NULL if the format isn't eligible
+	size_t _suffixLen;
+	bool _signed;			// "%d" or "%i" rather than "%u"
+	size_t _maxBytes;		// the size of the type "h" or "hh" names, or 0
+};
+
+template <>
+inline size_t PrintfBulk<char>::Digits(char* out, PrintfDigits::UINT64 u)
+{
+	return PrintfDigits::Decimal(out, u);
+}
+
+template <class CharT>
+inline size_t PrintfBulk<CharT>::Digits(CharT* out, PrintfDigits::UINT64 u)
+{
+	char tmp[PrintfDigits::MaxDigits + PrintfDigits::Slack];
+	size_t n = PrintfDigits::Decimal(tmp, u);
+	for (size_t i = 0; i < n; ++i)
+		out[i] = tmp[i];
+	return n;
+}
+
+template <class CharT, class T>
+void oprintf_array(std::basic_ostream<CharT>& ostm, const CharT* fmt, const T* values, size_t count)
+{
+	if (count == 0)
+		return;
+	oprintf(ostm, fmt, values[0]);
+
+	PrintfBulk<CharT> bulk(fmt);
+	if (bulk.template CanConvert<T>())
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4);
-		*(Base*)this = o.str();
+		bulk.Write(ostm, values + 1, count - 1);
 	}
+	else
+	{
+		for (size_t i = 1; i < count; ++i)
+			oprintf(ostm, fmt, values[i]);
+	}
+}
 
-	template <class A1, class A2, class A3, class A4, class A5>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5)
+//-----------------------------------------------------------------------------
+// Copies what is written to it into a buffer, and keeps whatever doesn't fit
+// for the next buffer: text that stays where it is (see PrintfSink) by
+// reference, fill by its character and count, and anything else by copying
+// it.
+
+template <class CharT>
+class PrintfWindowSink: public PrintfSink<CharT>
+{
+public:
+	PrintfWindowSink() : _buf(0), _size(0), _len(0), _first(0) {}
+
+	// Starts a new buffer, and copies into it what was kept from the last one.
+	void SetBuffer(CharT* buf, size_t size)
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4, a5);
-		*(Base*)this = o.str();
+		_buf = buf;
+		_size = size;
+		_len = 0;
+
+		for (; _first < _pending.size() && _len < _size; ++_first)
+		{
+			Piece& piece = _pending[_first];
+			size_t n;
+			if (piece.kind == Filled)
+				n = Fill(piece.fill, piece.len);
+			else
+				n = Copy((piece.kind == InPlace) ? piece.s : _spill.data() + piece.offset, piece.len);
+			if (n < piece.len)
+			{
+				piece.s += (piece.kind == InPlace) ? n : 0;
+				piece.offset += n;
+				piece.len -= n;
+				break;
+			}
+		}
+		if (_first == _pending.size())
+			Clear();
 	}
 
-	template <class A1, class A2, class A3, class A4, class A5, class A6>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6)
+	// Discards what was kept.
+	void Clear()
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4, a5, a6);
-		*(Base*)this = o.str();
+		_pending.clear();
+		_spill.clear();
+		_first = 0;
 	}
 
-	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7)
+	size_t Length() const   { return _len; }
+	bool Pending() const    { return _first < _pending.size(); }
+
+	virtual void Write(const CharT* s, size_t len)           { Put(s, len, false); }
+	virtual void WriteInPlace(const CharT* s, size_t len)    { Put(s, len, true); }
+	virtual void WriteArgInPlace(const CharT* s, size_t len) { Put(s, len, true); }
+
+	virtual void WriteFill(CharT c, size_t n)
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4, a5, a6, a7);
-		*(Base*)this = o.str();
+		if (!Pending())
+			n -= Fill(c, n);
+		if (n > 0)
+		{
+			Piece piece = { Filled, NULL, 0, n, c };
+			_pending.push_back(piece);
+		}
 	}
 
-	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8)
+private:
+	enum { InPlace, Spilled, Filled };
+
+	// what is kept: s[0..len), _spill[offset..offset+len), or len copies of
+	// fill
+	struct Piece
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4, a5, a6, a7, a8);
-		*(Base*)this = o.str();
+		int kind;
+		const CharT* s;
+		size_t offset;
+		size_t len;
+		CharT fill;
+	};
+
+	size_t Copy(const CharT* s, size_t len)
+	{
+		size_t n = (len < _size - _len) ? len : _size - _len;
+		if (n > 0)				// there is no buffer before the first Fill()
+			memcpy(_buf + _len, s, n * sizeof(CharT));
+		_len += n;
+		return n;
 	}
 
-	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9)
+	size_t Fill(CharT c, size_t len)
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9);
-		*(Base*)this = o.str();
+		size_t n = (len < _size - _len) ? len : _size - _len;
+		if (n > 0)
+			PrintfFill(_buf + _len, c, n);
+		_len += n;
+		return n;
 	}
 
-	template <class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
-	strprintfT(const CharT* fmt, A1 a1, A2 a2, A3 a3, A4 a4, A5 a5, A6 a6, A7 a7, A8 a8, A9 a9, A10 a10)
+	void Put(const CharT* s, size_t len, bool inPlace)
 	{
-		std::basic_ostringstream<CharT> o;
-		oprintf(o, fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
-		*(Base*)this = o.str();
+		if (!Pending())
+		{
+			size_t n = Copy(s, len);
+			s += n;
+			len -= n;
+		}
+		if (len == 0)
+			return;
+
+		if (inPlace)
+		{
+			Piece piece = { InPlace, s, 0, len, 0 };
+			_pending.push_back(piece);
+		}
+		else if (Pending() && _pending.back().kind == Spilled)
+		{
+			_spill.append(s, len);	// the last piece ends where _spill does
+			_pending.back().len += len;
+		}
+		else
+		{
+			Piece piece = { Spilled, NULL, _spill.size(), len, 0 };
+			_pending.push_back(piece);
+			_spill.append(s, len);
+		}
 	}
 
-	operator const CharT* () const { return std::basic_string<CharT>::c_str(); }
+	CharT* _buf;
+	size_t _size;
+	size_t _len;					// characters in _buf
+	std::vector<Piece> _pending;	// what didn't fit, in order
+	size_t _first;					// the first of them not yet copied
+	std::basic_string<CharT> _spill;	// copies of the pieces that needed them
 };
 
-typedef strprintfT<char> strprintf;
+//-----------------------------------------------------------------------------
+// PrintfResumable formats into buffers of whatever size is convenient, a
+// buffer at a time, so that for example a response can be written to a
+// non-blocking socket without building all of its text first:
+//
+//      PrintfResumable<char> r("%s: %d bytes\n");
+//      r << name << n;
+//      while (!r.Done())
+//      {
+//          char buf[4096];
+//          size_t len = r.Fill(buf, sizeof(buf));
+//          ... write buf[0..len) once the socket is writable ...
+//      }
+//
+// Each Fill() continues exactly where the last one stopped, even in the
+// middle of an argument.  The output is made of steps (the text before the
+// first specification, then each specification with the text after it), and
+// each step is done once: what of it doesn't fit is kept for the next
+// Fill(), by reference if it is the format's own text or a string written
+// as it is, as a character and a count if it is padding or zero fill, and
+// as a copy otherwise (a number, or a string of another width once it has
+// been converted).
+//
+// The arguments are captured the way positional ones are: numbers by value,
+// but strings and printf_formatter types by pointer, so those must stay
+// alive until Done().  There may be up to 32 arguments, counting '*' widths
+// and precisions.
+
+template <class CharT>
+struct PrintfResumableWindow
+{
+	PrintfWindowSink<CharT> _window;	// a base, so that it is built before Printf
+};
 
-#ifdef _MSC_VER
-typedef strprintfT<wchar_t> wstrprintf;
+template <class CharT>
+class PrintfResumable: private PrintfResumableWindow<CharT>, public Printf<CharT>
+{
+public:
+	PrintfResumable(const CharT* fmt)
+		: Printf<CharT>(this->_window, fmt), _step(0)
+	{
+		// The Printf constructor has written the text in front of the first
+		// specification, before there was a buffer; the first Fill() writes
+		// it again.
+		this->_window.Clear();
+		this->_pos = 0;
+		this->_deferred = true;
+	}
+
+	~PrintfResumable()
+	{
+		// giving up part way is not an error
+		if (!Done())
+			while (this->_fmt[this->_pos] != '\0')
+				++this->_pos;
+	}
+
+	bool Done() const
+		{ return _step == NumSteps() && !this->_window.Pending(); }
+
+	// Writes as much of the rest of the output as fits in buf[0..size), and
+	// returns the number of characters written.
+	size_t Fill(CharT* buf, size_t size)
+	{
+		assertmsg(size > 0, "printf: Buffer is too small");
+		assertmsg(this->_numPositional == 0 || this->_numCaptured == this->_numPositional,
+				  "printf: Too few arguments");
+
+		PrintfWindowSink<CharT>& window = this->_window;
+		window.SetBuffer(buf, size);
+
+		for (; _step < NumSteps() && !window.Pending(); ++_step)
+		{
+			if (_step == 0)
+				this->OutputStaticText();
+			else if (this->_numPositional != 0)
+				this->DoArg(this->_args[this->_argIndex[_step - 1]]);
+			else
+				this->DoArg(this->_args[_step - 1]);
+		}
+		return window.Length();
+	}
+
+private:
+	size_t NumSteps() const
+		{ return 1 + ((this->_numPositional != 0) ? this->_numSpecs : this->_numCaptured); }
+
+	size_t _step;		// the step that the next Fill() starts with
+};
+
+#ifdef STREAMPRINTF_COROUTINES
+//-----------------------------------------------------------------------------
+// A minimal generator coroutine type: a range over the values the coroutine
+// co_yields, each of which is valid until the iterator is advanced.
+
+template <class T>
+class PrintfGenerator
+{
+public:
+	struct promise_type
+	{
+		const T* _value;
+
+		PrintfGenerator get_return_object()
+			{ return PrintfGenerator(std::coroutine_handle<promise_type>::from_promise(*this)); }
+		std::suspend_always initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept   { return {}; }
+		std::suspend_always yield_value(const T& value) noexcept
+			{ _value = &value; return {}; }
+		void return_void() {}
+		void unhandled_exception() { throw; }
+	};
+
+	class iterator
+	{
+	public:
+		typedef std::ptrdiff_t difference_type;
+		typedef T value_type;
+
+		iterator() : _handle(nullptr) {}
+		explicit iterator(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+
+		const T& operator*() const { return *_handle.promise()._value; }
+		iterator& operator++()     { _handle.resume(); return *this; }
+		void operator++(int)       { ++*this; }
+		bool operator==(std::default_sentinel_t) const { return _handle.done(); }
+
+	private:
+		std::coroutine_handle<promise_type> _handle;
+	};
+
+	PrintfGenerator(PrintfGenerator&& other) noexcept : _handle(other._handle) { other._handle = nullptr; }
+	~PrintfGenerator()
+		{ if (_handle) _handle.destroy(); }
+
+	iterator begin()                   { _handle.resume(); return iterator(_handle); }
+	std::default_sentinel_t end() const { return std::default_sentinel; }
+
+private:
+	explicit PrintfGenerator(std::coroutine_handle<promise_type> handle) : _handle(handle) {}
+	PrintfGenerator(const PrintfGenerator&) = delete;
+	PrintfGenerator& operator=(const PrintfGenerator&) = delete;
+
+	std::coroutine_handle<promise_type> _handle;
+};
+
+//-----------------------------------------------------------------------------
+// printf_chunks() produces the output lazily, in chunks of at most chunkSize
+// characters, so that even a huge report can be streamed to a compressor or
+// a socket with no more than one chunk in memory:
+//
+//      for (std::string_view chunk : printf_chunks(64 * 1024, "%s\n", report))
+//          gz.write(chunk.data(), chunk.size());
+//
+// Each chunk takes time in proportion to its size, however far into a long
+// argument it starts, since PrintfResumable never formats anything twice.
+// Strings of the output's own width are referred to where they are, and
+// padding is kept as a count, so neither takes memory however long it is.
+// What is held whole until its last chunk has been produced is a string of
+// another width, which is converted in one go, and the text of a
+// floating-point number, which can be long only with a huge precision.  An
+// empty output produces no chunks.
+//
+// The arguments are copied into the coroutine, but strings passed as
+// pointers must stay alive until the last chunk has been consumed.
+
+template <class CharT, class... Args>
+PrintfGenerator<std::basic_string_view<CharT>> printf_chunks(size_t chunkSize, const CharT* fmt, Args... args)
+{
+	PrintfResumable<CharT> r(fmt);
+	(r << ... << args);
+
+	std::unique_ptr<CharT[]> buf(new CharT[chunkSize]);
+	while (!r.Done())
+	{
+		size_t len = r.Fill(buf.get(), chunkSize);
+		if (len > 0)
+			co_yield std::basic_string_view<CharT>(buf.get(), len);
+	}
+}
 #endif
+
+//-----------------------------------------------------------------------------
+// The sink of a Printf that writes the text of an argument of another Printf:
+// everything it writes goes to the outer sink as part of that argument, and
+// the record doesn't end until the outer Printf is done.
+
+template <class CharT>
+class PrintfNestedSink: public PrintfSink<CharT>
+{
+public:
+	explicit PrintfNestedSink(PrintfSink<CharT>& sink) : _sink(sink) {}
+
+	virtual void Write(const CharT* s, size_t len)           { _sink.WriteArg(s, len); }
+	virtual void WriteArg(const CharT* s, size_t len)        { _sink.WriteArg(s, len); }
+	virtual void WriteInPlace(const CharT* s, size_t len)    { _sink.WriteArgInPlace(s, len); }
+	virtual void WriteArgInPlace(const CharT* s, size_t len) { _sink.WriteArgInPlace(s, len); }
+	virtual void WriteFill(CharT c, size_t n)                { _sink.WriteFill(c, n); }
+
+private:
+	PrintfNestedSink(const PrintfNestedSink&);
+	PrintfNestedSink& operator=(const PrintfNestedSink&);
+
+	PrintfSink<CharT>& _sink;
+};
+
+//-----------------------------------------------------------------------------
+// lazyprintf() is a strprintf() that doesn't format until the result is
+// used: when it is converted to a string or a (const CharT*), or written to
+// a stream, or passed to oprintf() as a "%s" argument.  If it is never used,
+// for example because it was passed to a logger that is turned off, all it
+// costs is capturing the arguments:
+//
+//      debugLog(lazyprintf("state %s after %d steps", Describe(x), n));
+//
+// It holds references to its arguments, so it must be used before the end of
+// the statement that creates it, the way a strprintf() temporary would be.
+// Convert it with "std::string s = ..." or str(), since "std::string s(...)"
+// is ambiguous.
+
+struct PrintfNoArg
+{
+};
+
+inline const PrintfNoArg& PrintfNone()
+{
+	static const PrintfNoArg none = PrintfNoArg();
+	return none;
+}
+
+template <class CharT, class T>
+inline void PrintfFeed(Printf<CharT>& p, const T& a)
+{
+	p << a;
+}
+
+template <class CharT>
+inline void PrintfFeed(Printf<CharT>&, const PrintfNoArg&)
+{
+}
+
+template <class CharT, class A1 = PrintfNoArg, class A2 = PrintfNoArg, class A3 = PrintfNoArg, class A4 = PrintfNoArg, class A5 = PrintfNoArg, class A6 = PrintfNoArg, class A7 = PrintfNoArg, class A8 = PrintfNoArg, class A9 = PrintfNoArg, class A10 = PrintfNoArg>
+class lazyprintfT
+{
+public:
+	lazyprintfT(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6, const A7& a7, const A8& a8, const A9& a9, const A10& a10)
+		: _fmt(fmt), _a1(a1), _a2(a2), _a3(a3), _a4(a4), _a5(a5), _a6(a6), _a7(a7), _a8(a8), _a9(a9), _a10(a10), _formatted(false) {}
+	lazyprintfT(const lazyprintfT& other)
+		: _fmt(other._fmt), _a1(other._a1), _a2(other._a2), _a3(other._a3), _a4(other._a4), _a5(other._a5),
+		  _a6(other._a6), _a7(other._a7), _a8(other._a8), _a9(other._a9), _a10(other._a10),
+		  _s(other._s), _formatted(other._formatted) {}
+
+	// formats to an ostream or a PrintfSink
+	template <class OutputT>
+	void Format(OutputT& out) const
+	{
+		Printf<CharT> p(out, _fmt);
+		PrintfFeed(p, _a1);
+		PrintfFeed(p, _a2);
+		PrintfFeed(p, _a3);
+		PrintfFeed(p, _a4);
+		PrintfFeed(p, _a5);
+		PrintfFeed(p, _a6);
+		PrintfFeed(p, _a7);
+		PrintfFeed(p, _a8);
+		PrintfFeed(p, _a9);
+		PrintfFeed(p, _a10);
+	}
+
+	const std::basic_string<CharT>& str() const
+	{
+		if (!_formatted)
+		{
+			PrintfStringSink<CharT> sink(_s);
+			Format(sink);
+			_formatted = true;
+		}
+		return _s;
+	}
+
+	const CharT* c_str() const                   { return str().c_str(); }
+	operator const CharT* () const               { return str().c_str(); }
+	operator std::basic_string<CharT> () const   { return str(); }
+
+private:
+	lazyprintfT& operator=(const lazyprintfT&);
+
+	const CharT* _fmt;
+	const A1& _a1;
+	const A2& _a2;
+	const A3& _a3;
+	const A4& _a4;
+	const A5& _a5;
+	const A6& _a6;
+	const A7& _a7;
+	const A8& _a8;
+	const A9& _a9;
+	const A10& _a10;
+	mutable std::basic_string<CharT> _s;
+	mutable bool _formatted;
+};
+
+template <class CharT>
+inline lazyprintfT<CharT> lazyprintf(const CharT* fmt)
+{
+	return lazyprintfT<CharT>(fmt, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1>
+inline lazyprintfT<CharT, A1> lazyprintf(const CharT* fmt, const A1& a1)
+{
+	return lazyprintfT<CharT, A1>(fmt, a1, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2>
+inline lazyprintfT<CharT, A1, A2> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2)
+{
+	return lazyprintfT<CharT, A1, A2>(fmt, a1, a2, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3>
+inline lazyprintfT<CharT, A1, A2, A3> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3)
+{
+	return lazyprintfT<CharT, A1, A2, A3>(fmt, a1, a2, a3, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4>
+inline lazyprintfT<CharT, A1, A2, A3, A4> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4>(fmt, a1, a2, a3, a4, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5>
+inline lazyprintfT<CharT, A1, A2, A3, A4, A5> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4, A5>(fmt, a1, a2, a3, a4, a5, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6>
+inline lazyprintfT<CharT, A1, A2, A3, A4, A5, A6> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4, A5, A6>(fmt, a1, a2, a3, a4, a5, a6, PrintfNone(), PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7>
+inline lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6, const A7& a7)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7>(fmt, a1, a2, a3, a4, a5, a6, a7, PrintfNone(), PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8>
+inline lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6, const A7& a7, const A8& a8)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8>(fmt, a1, a2, a3, a4, a5, a6, a7, a8, PrintfNone(), PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9>
+inline lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6, const A7& a7, const A8& a8, const A9& a9)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9>(fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9, PrintfNone());
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+inline lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10> lazyprintf(const CharT* fmt, const A1& a1, const A2& a2, const A3& a3, const A4& a4, const A5& a5, const A6& a6, const A7& a7, const A8& a8, const A9& a9, const A10& a10)
+{
+	return lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10>(fmt, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10);
+}
+
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+inline std::basic_ostream<CharT>& operator<<(std::basic_ostream<CharT>& ostm, const lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10>& s)
+{
+	s.Format(ostm);
+	return ostm;
+}
+
+// as an argument of oprintf() and the like, it is written straight to the output
+template <class CharT, class A1, class A2, class A3, class A4, class A5, class A6, class A7, class A8, class A9, class A10>
+struct printf_formatter<lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10> >
+{
+	static const char* conversions() { return "s"; }
+
+	static void format(PrintfSink<CharT>& sink, const PrintfSpec<CharT>& spec, const lazyprintfT<CharT, A1, A2, A3, A4, A5, A6, A7, A8, A9, A10>& s)
+	{
+		if (spec.width == 0 && spec.precision < 0)
+		{
+			PrintfNestedSink<CharT> nested(sink);
+			s.Format(nested);
+		}
+		else
+		{
+			const std::basic_string<CharT>& str = s.str();
+			spec.WriteJustified(sink, str.data(), str.size());
+		}
+	}
+};
+
+#endif // STREAMPRINTF_H
@@ -0,0 +1,125 @@
+// Checks that PrintfAsyncSink gets everything to a target that only writes
+// out a record on EndRecord(), on Flush() and on destruction, and that
+// records from different threads never mix.
+
+#include "asyncprintf.h"
+#include "fdprintf.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+static void Fail(const char* what)
+{
+	oprintf(std::cerr, "FAIL %s\n", what);
+	++failures;
+}
+
+// a temporary file, removed when it goes away
+class TempFile
+{
+public:
+	TempFile()
+	{
+		char name[] = "/tmp/asyncprintf_testXXXXXX";
+		_fd = mkstemp(name);
+		_name = name;
+	}
+	~TempFile() { close(_fd); unlink(_name.c_str()); }
+
+	int Fd() const { return _fd; }
+	std::string Contents() const
+	{
+		std::string s;
+		char buf[4096];
+		ssize_t n;
+		for (off_t offset = 0; (n = pread(_fd, buf, sizeof(buf), offset)) > 0; offset += n)
+			s.append(buf, (size_t) n);
+		return s;
+	}
+
+private:
+	int _fd;
+	std::string _name;
+};
+
+static void CheckFlush()
+{
+	TempFile file;
+	PrintfWritevSink fdSink(file.Fd());
+	std::string expect;
+	{
+		PrintfAsyncSink<char> async(fdSink, 64 * 1024, 10000);
+		oprintf(async, "%s %d\n", "first", 1);
+		expect += "first 1\n";
+		async.Flush();
+		if (file.Contents() != expect)
+			Fail("Flush() didn't reach a writev sink");
+
+		oprintf(async, "%s %d\n", "second", 2);
+		expect += "second 2\n";
+	}
+	if (file.Contents() != expect)
+		Fail("destruction didn't reach a writev sink");
+}
+
+static void Writer(PrintfAsyncSink<char>* async, int thread, int numRecords)
+{
+	for (int i = 0; i < numRecords; ++i)
+		oprintf(*async, "thread %d record %d %s end\n", thread, i, "payload payload payload");
+}
+
+static void CheckThreads()
+{
+	enum { NumThreads = 4, NumRecords = 5000 };
+
+	TempFile file;
+	PrintfWritevSink fdSink(file.Fd());
+	{
+		// small buffers, so that records are split across them
+		PrintfAsyncSink<char> async(fdSink, 256, 1);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < NumThreads; ++t)
+			threads.push_back(std::thread(Writer, &async, t, (int) NumRecords));
+		for (size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+	}
+
+	// each thread's records must be whole, and in order
+	std::string s = file.Contents();
+	int next[NumThreads] = { 0 };
+	size_t numLines = 0;
+	for (size_t pos = 0, end; pos < s.size(); pos = end + 1)
+	{
+		end = s.find('\n', pos);
+		if (end == std::string::npos)
+			end = s.size();
+		std::string line = s.substr(pos, end - pos);
+		int t, i;
+		char rest[64];
+		if (sscanf(line.c_str(), "thread %d record %d %63[a-z ]", &t, &i, rest) != 3
+			|| t < 0 || t >= NumThreads || i != next[t]
+			|| line != strprintf("thread %d record %d %s end", t, i, "payload payload payload"))
+		{
+			oprintf(std::cerr, "bad line: \"%s\"\n", line);
+			Fail("records from different threads mixed");
+			return;
+		}
+		++next[t];
+		++numLines;
+	}
+	if (numLines != NumThreads * NumRecords)
+		Fail("records are missing");
+}
+
+int main()
+{
+	CheckFlush();
+	CheckThreads();
+
+	if (failures == 0)
+		std::cout << "asyncprintf: ok\n";
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,89 @@
+// Checks the PrintfDigits kernels against snprintf(): decimal digits around
+// the 8-, 16- and 20-digit boundaries where the vectorized kernel changes the
+// number of blocks, every power of two, and pseudo-random values of every
+// length; octal, hex and binary digits of the same values.
+
+#include "streamprintf.h"
+#include <string>
+
+typedef PrintfDigits::UINT64 UINT64;
+
+static int failures = 0;
+
+static std::string Reference(const char* fmt, UINT64 u)
+{
+	char buf[32];
+	snprintf(buf, sizeof(buf), fmt, u);
+	return buf;
+}
+
+static std::string ReferenceBinary(UINT64 u)
+{
+	std::string s;
+	do
+	{
+		s.insert(s.begin(), (char) ('0' + (unsigned) (u & 1)));
+		u >>= 1;
+	} while (u != 0);
+	return s;
+}
+
+static void Compare(const char* kernel, UINT64 u, const char* out, size_t len, const std::string& want)
+{
+	if (std::string(out, len) != want)
+	{
+		oprintf(std::cerr, "FAIL %s(%llu): got \"%s\", want \"%s\"\n", kernel, u, std::string(out, len), want);
+		++failures;
+	}
+}
+
+static void Check(UINT64 u)
+{
+	char out[PrintfDigits::MaxDigits + PrintfDigits::Slack];
+	std::string decimal = Reference("%llu", u);
+
+	Compare("Decimal", u, out, PrintfDigits::Decimal(out, u), decimal);
+	Compare("DecimalScalar", u, out, PrintfDigits::DecimalScalar(out, u), decimal);
+	Compare("Radix/8", u, out, PrintfDigits::Radix(out, u, 3, false), Reference("%llo", u));
+	Compare("Radix/16", u, out, PrintfDigits::Radix(out, u, 4, false), Reference("%llx", u));
+	Compare("Radix/16", u, out, PrintfDigits::Radix(out, u, 4, true), Reference("%llX", u));
+	Compare("Binary", u, out, PrintfDigits::Binary(out, u), ReferenceBinary(u));
+}
+
+int main()
+{
+	// 10^k - 1, 10^k and 10^k + 1 (and a little further) for every k
+	UINT64 power = 1;
+	for (int k = 0; k <= 19; ++k, power *= 10)
+	{
+		for (UINT64 d = 0; d <= 3; ++d)
+		{
+			Check(power + d);
+			Check(power - 1 - d);
+		}
+	}
+
+	for (int k = 0; k < 64; ++k)
+	{
+		UINT64 p = (UINT64) 1 << k;
+		Check(p - 1);
+		Check(p);
+		Check(p + 1);
+	}
+	Check(~(UINT64) 0);
+	Check(~(UINT64) 0 - 1);
+
+	// values of every bit length, from a fixed xorshift sequence
+	UINT64 x = 88172645463325252ULL;
+	for (int i = 0; i < 200000; ++i)
+	{
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		Check(x >> (i % 64));
+	}
+
+	if (failures == 0)
+		std::cout << "digits: ok\n";
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,60 @@
+// Checks that oprintf_array() writes every element the way oprintf() writes
+// it on its own, whether or not the bulk path can be taken.
+
+#include "streamprintf.h"
+#include <limits.h>
+
+static int failures = 0;
+
+template <class T>
+static void Check(const char* fmt, const T* values, size_t count)
+{
+	std::ostringstream bulk;
+	oprintf_array(bulk, fmt, values, count);
+
+	std::ostringstream each;
+	for (size_t i = 0; i < count; ++i)
+		oprintf(each, fmt, values[i]);
+
+	if (bulk.str() != each.str())
+	{
+		oprintf(std::cerr, "FAIL \"%s\": got \"%s\", want \"%s\"\n", fmt, bulk.str(), each.str());
+		++failures;
+	}
+}
+
+int main()
+{
+	const int ints[] = { -1, -2, 0, INT_MIN, INT_MAX };
+	const unsigned uints[] = { 4000000000u, 4000000000u, 0, UINT_MAX };
+	const long longs[] = { -1, LONG_MIN, LONG_MAX };
+	const unsigned long ulongs[] = { ULONG_MAX, ULONG_MAX, 1 };
+	const long long llongs[] = { -1, LLONG_MIN, LLONG_MAX };
+	const unsigned long long ullongs[] = { ULLONG_MAX, ULLONG_MAX, 1 };
+	const short shorts[] = { -1, SHRT_MIN, SHRT_MAX };
+	const unsigned short ushorts[] = { USHRT_MAX, USHRT_MAX, 1 };
+
+	// signedness of the conversion and of the elements, matching or not
+	Check("%u,", ints, 5);
+	Check("%d,", ints, 5);
+	Check("%i,", ints, 5);
+	Check("%d,", uints, 4);
+	Check("%u,", uints, 4);
+	Check("%ld ", longs, 3);
+	Check("%lu ", longs, 3);
+	Check("%ld ", ulongs, 3);
+	Check("%lld\n", llongs, 3);
+	Check("%llu\n", llongs, 3);
+	Check("%lld\n", ullongs, 3);
+	Check("%llu\n", ullongs, 3);
+
+	// "h" with the types it names
+	Check("[%hd]", shorts, 3);
+	Check("[%hu]", shorts, 3);
+	Check("[%hd]", ushorts, 3);
+	Check("[%hu]", ushorts, 3);
+
+	if (failures == 0)
+		std::cout << "oprintf_array: ok\n";
+	return failures == 0 ? 0 : 1;
+}
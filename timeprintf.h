@@ -0,0 +1,168 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// Formatting of std::chrono::system_clock time points (C++11).
+//
+// Usage:
+//      auto now = std::chrono::system_clock::now();
+//      oprintf(log, "%T %s\n", now, msg);          // 2024-05-01 14:03:27
+//      oprintf(log, "%.3T %s\n", now, msg);        // 2024-05-01 14:03:27.042
+//
+//      // a strftime() format of your own, and UTC instead of local time
+//      oprintf(log, "%.6T\n", printf_time(now, "%Y-%m-%dT%H:%M:%S", true));
+//
+// The precision is the number of digits of the fraction of a second (up to
+// 9), and the width and '-' flag work as for "%s".
+//
+// Every log line starts with a timestamp, and localtime() and strftime() cost
+// more than formatting the rest of the line, so each thread keeps the text of
+// the last second it formatted: until the second changes, only the digits of
+// the fraction are written afresh.
+
+#ifndef TIMEPRINTF_H
+#define TIMEPRINTF_H
+
+#include "streamprintf.h"
+#include <chrono>
+#include <time.h>
+
+//-----------------------------------------------------------------------------
+// A time point together with the strftime() format to write it with.
+
+template <class Duration>
+struct PrintfTime
+{
+	std::chrono::time_point<std::chrono::system_clock, Duration> time;
+	const char* format;
+	bool utc;
+};
+
+template <class Duration>
+inline PrintfTime<Duration> printf_time(const std::chrono::time_point<std::chrono::system_clock, Duration>& time,
+										const char* format = "%Y-%m-%d %H:%M:%S", bool utc = false)
+{
+	PrintfTime<Duration> t = { time, format, utc };
+	return t;
+}
+
+//-----------------------------------------------------------------------------
+// Writes the text of a time to 'out', which must have room for
+// MaxLength characters, and returns its length.
+
+class PrintfTimeFormatter
+{
+public:
+	enum { MaxLength = 80, MaxPattern = 64 };
+
+	template <class Duration>
+	static size_t Format(char* out, const PrintfTime<Duration>& t, int precision)
+	{
+		using namespace std::chrono;
+
+		// whole seconds, rounded down even before 1970, and the fraction
+		Duration sinceEpoch = t.time.time_since_epoch();
+		seconds secs = duration_cast<seconds>(sinceEpoch);
+		if (secs > sinceEpoch)
+			secs -= seconds(1);
+		long long nanos = duration_cast<nanoseconds>(sinceEpoch - secs).count();
+
+		size_t len = Prefix(out, (time_t) secs.count(), t.format, t.utc);
+		if (precision > 0)
+		{
+			if (precision > 9)
+				precision = 9;
+			static const long long pow10[] = { 1, 10, 100, 1000, 10000, 100000,
+				1000000, 10000000, 100000000, 1000000000 };
+			char digits[PrintfDigits::MaxDigits + PrintfDigits::Slack];
+			size_t n = PrintfDigits::Decimal(digits, (PrintfDigits::UINT64) (nanos / pow10[9 - precision]));
+
+			out[len++] = '.';
+			for (size_t i = n; i < (size_t) precision; ++i)
+				out[len++] = '0';
+			memcpy(out + len, digits, n);
+			len += n;
+		}
+		return len;
+	}
+
+private:
+	// the strftime() text of the second, from this thread's cache if it's the
+	// same second, format and time zone as last time
+	static size_t Prefix(char* out, time_t secs, const char* format, bool utc)
+	{
+		struct Cache
+		{
+			time_t secs;
+			bool utc;
+			bool valid;
+			char format[MaxPattern];
+			char text[MaxLength];
+			size_t len;
+		};
+		static thread_local Cache cache = { 0, false, false, { 0 }, { 0 }, 0 };
+
+		if (!cache.valid || cache.secs != secs || cache.utc != utc || strcmp(cache.format, format) != 0)
+		{
+			struct tm tm;
+#ifdef _MSC_VER
+			if (utc)
+				gmtime_s(&tm, &secs);
+			else
+				localtime_s(&tm, &secs);
+#else
+			if (utc)
+				gmtime_r(&secs, &tm);
+			else
+				localtime_r(&secs, &tm);
+#endif
+			// leave room for the fraction
+			cache.len = strftime(cache.text, MaxLength - 11, format, &tm);
+			cache.secs = secs;
+			cache.utc = utc;
+
+			size_t patternLen = strlen(format);
+			cache.valid = patternLen < MaxPattern;		// a longer one isn't cached
+			if (cache.valid)
+				memcpy(cache.format, format, patternLen + 1);
+		}
+
+		memcpy(out, cache.text, cache.len);
+		return cache.len;
+	}
+};
+
+//-----------------------------------------------------------------------------
+template <class Duration>
+struct printf_formatter<PrintfTime<Duration> >
+{
+	static const char* conversions() { return "T"; }
+
+	template <class CharT>
+	static void format(PrintfSink<CharT>& sink, const PrintfSpec<CharT>& spec, const PrintfTime<Duration>& t)
+	{
+		char text[PrintfTimeFormatter::MaxLength];
+		size_t len = PrintfTimeFormatter::Format(text, t, spec.precision);
+
+		CharT buf[PrintfTimeFormatter::MaxLength];
+		len = PrintfUtf::Transcode(buf, text, len, PrintfTimeFormatter::MaxLength);
+
+		PrintfSpec<CharT> whole = spec;
+		whole.precision = -1;		// the precision was the fraction's
+		whole.WriteJustified(sink, buf, len);
+	}
+};
+
+template <class Duration>
+struct printf_formatter<std::chrono::time_point<std::chrono::system_clock, Duration> >
+{
+	static const char* conversions() { return "T"; }
+
+	template <class CharT>
+	static void format(PrintfSink<CharT>& sink, const PrintfSpec<CharT>& spec,
+					   const std::chrono::time_point<std::chrono::system_clock, Duration>& time)
+	{
+		printf_formatter<PrintfTime<Duration> >::format(sink, spec, printf_time(time));
+	}
+};
+
+#endif // TIMEPRINTF_H
@@ -0,0 +1,490 @@
+// Copyright (c) 2001 Mike Morearty
+// Original code and docs: http://www.morearty.com/code/streamprintf
+//
+// A sink that writes to a file asynchronously, with io_uring on Linux and a
+// pool of pwrite() threads elsewhere (POSIX, C++11).
+//
+// Usage:
+//      PrintfUringSink log("app.log");
+//      oprintf(log, "%s %d\n", what, n);
+//      ...
+//      log.Flush();                        // optional; the destructor does it
+//
+// Output is collected in one of a fixed set of buffers.  When it is full (or
+// on Flush()), it is handed to the kernel as a write at the end of the file,
+// and the next free buffer is used while that write completes; buffers come
+// back to the free set as their writes complete.  So the formatting thread
+// doesn't wait for the disk unless every buffer is still being written.
+//
+// With io_uring, the buffers are registered with the kernel once, so each
+// write is an IORING_OP_WRITE_FIXED with no per-write page pinning, and
+// completions are collected without a system call whenever a buffer is
+// needed.  io_uring is used through its system calls directly, so liburing
+// isn't needed.  If it is unavailable (an old kernel, a seccomp policy, a
+// too-small RLIMIT_MEMLOCK for the buffers, or not Linux at all), a pool of
+// threads does the writes with pwrite() instead; UsingUring() says which.
+//
+// The file is appended to if it exists.  Only one thread may write to the
+// sink at a time.
+
+#ifndef URINGPRINTF_H
+#define URINGPRINTF_H
+
+#include "streamprintf.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__linux__) && defined(__has_include)
+	#if __has_include(<linux/io_uring.h>)
+		#include <linux/io_uring.h>
+		#include <sys/mman.h>
+		#include <sys/syscall.h>
+		#include <sys/uio.h>
+		#ifdef __NR_io_uring_setup
+			#define STREAMPRINTF_URING
+		#endif
+	#endif
+#endif
+
+//-----------------------------------------------------------------------------
+// The raw io_uring: a submission and a completion ring shared with the
+// kernel.  Only one thread uses it, so the only synchronization needed is
+// with the kernel, through the ring heads and tails.
+
+#ifdef STREAMPRINTF_URING
+class PrintfUring
+{
+public:
+	PrintfUring() : _ringFd(-1), _sqRing(NULL), _cqRing(NULL), _sqes(NULL) {}
+	~PrintfUring() { Close(); }
+
+	// Sets up a ring for 'entries' writes in flight, and registers the
+	// buffers.  Returns false, with nothing set up, if io_uring can't be used.
+	bool Open(unsigned entries, const iovec* buffers, unsigned numBuffers)
+	{
+		io_uring_params params;
+		memset(&params, 0, sizeof(params));
+		_ringFd = (int) syscall(__NR_io_uring_setup, entries, &params);
+		if (_ringFd < 0)
+			return false;
+
+		_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single && _cqRingSize > _sqRingSize)
+			_sqRingSize = _cqRingSize;
+
+		_sqRing = Map(_sqRingSize, IORING_OFF_SQ_RING);
+		_cqRing = single ? _sqRing : Map(_cqRingSize, IORING_OFF_CQ_RING);
+		_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		_sqes = (io_uring_sqe*) Map(_sqesSize, IORING_OFF_SQES);
+		if (_sqRing == NULL || _cqRing == NULL || _sqes == NULL
+			|| syscall(__NR_io_uring_register, _ringFd, IORING_REGISTER_BUFFERS, buffers, numBuffers) != 0)
+		{
+			Close();
+			return false;
+		}
+
+		char* sq = (char*) _sqRing;
+		_sqHead = (unsigned*) (sq + params.sq_off.head);
+		_sqTail = (unsigned*) (sq + params.sq_off.tail);
+		_sqMask = *(unsigned*) (sq + params.sq_off.ring_mask);
+		_sqArray = (unsigned*) (sq + params.sq_off.array);
+		char* cq = (char*) _cqRing;
+		_cqHead = (unsigned*) (cq + params.cq_off.head);
+		_cqTail = (unsigned*) (cq + params.cq_off.tail);
+		_cqMask = *(unsigned*) (cq + params.cq_off.ring_mask);
+		_cqes = (io_uring_cqe*) (cq + params.cq_off.cqes);
+		return true;
+	}
+
+	// Queues a write from registered buffer 'index' and submits it.  There
+	// must be room in the ring, which there is if no more writes are in
+	// flight than there are entries.  Returns true if the kernel took the
+	// write, which will then complete through Reap() even if
+	// io_uring_enter() failed.  Returns false, with errno set, if it didn't;
+	// the entry is then taken back out of the ring, so the buffer is free.
+	bool Write(int fd, unsigned index, const char* p, size_t len, off_t offset)
+	{
+		unsigned tail = *_sqTail;
+		unsigned slot = tail & _sqMask;
+		io_uring_sqe* sqe = &_sqes[slot];
+		memset(sqe, 0, sizeof(*sqe));
+		sqe->opcode = IORING_OP_WRITE_FIXED;
+		sqe->fd = fd;
+		sqe->addr = (unsigned long long) (size_t) p;
+		sqe->len = (unsigned) len;
+		sqe->off = (unsigned long long) offset;
+		sqe->buf_index = (unsigned short) index;
+		sqe->user_data = index;
+		_sqArray[slot] = slot;
+		__atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+		// Only this thread enters the ring, so the kernel moves the head past
+		// the entry here or not at all.
+		for (;;)
+		{
+			long submitted = syscall(__NR_io_uring_enter, _ringFd, 1, 0, 0, NULL, 0);
+			if (__atomic_load_n(_sqHead, __ATOMIC_ACQUIRE) != tail)
+				return true;
+			if (submitted >= 0)
+				errno = EIO;
+			else if (errno == EINTR || errno == EAGAIN)
+				continue;
+			__atomic_store_n(_sqTail, tail, __ATOMIC_RELEASE);
+			return false;
+		}
+	}
+
+	// Calls done(index, result) for each write that has completed, first
+	// waiting for at least one if 'wait' is set.  'result' is the number of
+	// bytes written or -errno.
+	template <class Done>
+	void Reap(bool wait, Done done)
+	{
+		unsigned head = *_cqHead;
+		if (wait && head == __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE))
+			syscall(__NR_io_uring_enter, _ringFd, 0, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+		for (; head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE); ++head)
+		{
+			const io_uring_cqe& cqe = _cqes[head & _cqMask];
+			unsigned index = (unsigned) cqe.user_data;
+			int result = cqe.res;
+			__atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+			done(index, result);
+		}
+	}
+
+private:
+	PrintfUring(const PrintfUring&);
+	PrintfUring& operator=(const PrintfUring&);
+
+	void* Map(size_t size, unsigned long long offset)
+	{
+		void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ringFd, (off_t) offset);
+		return (p == MAP_FAILED) ? NULL : p;
+	}
+
+	void Close()
+	{
+		if (_sqes != NULL)
+			munmap(_sqes, _sqesSize);
+		if (_cqRing != NULL && _cqRing != _sqRing)
+			munmap(_cqRing, _cqRingSize);
+		if (_sqRing != NULL)
+			munmap(_sqRing, _sqRingSize);
+		if (_ringFd >= 0)
+			close(_ringFd);		// which also unregisters the buffers
+		_ringFd = -1;
+		_sqRing = _cqRing = NULL;
+		_sqes = NULL;
+	}
+
+	int _ringFd;
+	void* _sqRing;
+	void* _cqRing;
+	io_uring_sqe* _sqes;
+	size_t _sqRingSize, _cqRingSize, _sqesSize;
+	unsigned* _sqHead;
+	unsigned* _sqTail;
+	unsigned _sqMask;
+	unsigned* _sqArray;
+	unsigned* _cqHead;
+	unsigned* _cqTail;
+	unsigned _cqMask;
+	io_uring_cqe* _cqes;
+};
+#endif
+
+//-----------------------------------------------------------------------------
+class PrintfUringSink: public PrintfSink<char>
+{
+public:
+	enum { DefaultBufferSize = 256 * 1024, DefaultNumBuffers = 8, DefaultNumThreads = 2 };
+
+	explicit PrintfUringSink(const char* path, size_t bufferSize = DefaultBufferSize,
+							 int numBuffers = DefaultNumBuffers, int numThreads = DefaultNumThreads)
+		: _fd(open(path, O_WRONLY | O_CREAT, 0644)), _bufferSize(bufferSize), _numBuffers(numBuffers),
+		  _buffers(new char[bufferSize * numBuffers]), _slots(new Slot[numBuffers]),
+		  _free(new int[numBuffers]), _numFree(0), _current(-1), _len(0), _offset(0),
+		  _usingUring(false), _workers(NULL), _numWorkers(0), _jobs(NULL), _numJobs(0), _firstJob(0),
+		  _stop(false), _error(0)
+	{
+		struct stat st;
+		if (_fd < 0 || fstat(_fd, &st) != 0)
+		{
+			Fail(errno);
+			if (_fd >= 0)
+				close(_fd);
+			_fd = -1;
+			return;
+		}
+		_offset = st.st_size;
+		for (int i = 0; i < numBuffers; ++i)
+			_free[_numFree++] = i;
+
+#ifdef STREAMPRINTF_URING
+		iovec* iov = new iovec[numBuffers];
+		for (int i = 0; i < numBuffers; ++i)
+		{
+			iov[i].iov_base = _buffers + i * bufferSize;
+			iov[i].iov_len = bufferSize;
+		}
+		_usingUring = _uring.Open((unsigned) numBuffers, iov, (unsigned) numBuffers);
+		delete[] iov;
+		if (_usingUring)
+			return;
+#endif
+		_jobs = new int[numBuffers];
+		_workers = new std::thread[numThreads];
+		_numWorkers = numThreads;
+		for (int i = 0; i < numThreads; ++i)
+			_workers[i] = std::thread(&PrintfUringSink::WorkerLoop, this);
+	}
+
+	virtual ~PrintfUringSink()
+	{
+		if (_fd >= 0)
+		{
+			Flush();
+			Drain();
+		}
+		if (!_usingUring && _fd >= 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_workReady.notify_all();
+			for (int i = 0; i < _numWorkers; ++i)
+				_workers[i].join();
+			delete[] _workers;
+			delete[] _jobs;
+		}
+		if (_fd >= 0)
+			close(_fd);
+		delete[] _free;
+		delete[] _slots;
+		delete[] _buffers;
+	}
+
+	virtual void Write(const char* s, size_t len)
+	{
+		if (_fd < 0)
+			return;				// see Error()
+
+		while (len > 0)
+		{
+			if (_current < 0)
+			{
+				_current = Acquire();
+				_len = 0;
+			}
+			size_t n = (len < _bufferSize - _len) ? len : _bufferSize - _len;
+			memcpy(_buffers + _current * _bufferSize + _len, s, n);
+			_len += n;
+			s += n;
+			len -= n;
+			if (_len == _bufferSize)
+				Flush();
+		}
+	}
+
+	// Starts writing what has been collected so far, without waiting for it.
+	void Flush()
+	{
+		if (_current >= 0 && _len > 0)
+		{
+			Submit(_current, _len);
+			_current = -1;
+		}
+	}
+
+	// Waits until everything flushed so far has been written.
+	void Drain()
+	{
+		int have = (_current >= 0) ? 1 : 0;
+#ifdef STREAMPRINTF_URING
+		if (_usingUring)
+		{
+			while (_numFree + have < _numBuffers)
+				Reap(true);
+			return;
+		}
+#endif
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (_numFree + have < _numBuffers)
+			_bufferFree.wait(lock);
+	}
+
+	bool UsingUring() const { return _usingUring; }
+
+	// The errno of the first write that failed, or 0.  The text of a write
+	// that fails is lost.
+	int Error() const { return _error.load(); }
+
+private:
+	PrintfUringSink(const PrintfUringSink&);
+	PrintfUringSink& operator=(const PrintfUringSink&);
+
+	// a buffer that is being written
+	struct Slot
+	{
+		off_t offset;		// where the rest goes in the file
+		size_t done;		// how much has been written
+		size_t len;
+	};
+
+	void Submit(int index, size_t len)
+	{
+		Slot& slot = _slots[index];
+		slot.offset = _offset;
+		slot.done = 0;
+		slot.len = len;
+		_offset += len;
+
+#ifdef STREAMPRINTF_URING
+		if (_usingUring)
+		{
+			// if the kernel didn't take the write, it never will, so the
+			// buffer is free again at once
+			if (!_uring.Write(_fd, index, _buffers + index * _bufferSize, len, slot.offset))
+			{
+				Fail(errno);
+				_free[_numFree++] = index;
+			}
+			return;
+		}
+#endif
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+			_jobs[(_firstJob + _numJobs++) % _numBuffers] = index;
+		}
+		_workReady.notify_one();
+	}
+
+	// a free buffer, waiting for one if need be
+	int Acquire()
+	{
+#ifdef STREAMPRINTF_URING
+		if (_usingUring)
+		{
+			Reap(false);
+			while (_numFree == 0)
+				Reap(true);
+			return _free[--_numFree];
+		}
+#endif
+		std::unique_lock<std::mutex> lock(_mutex);
+		while (_numFree == 0)
+			_bufferFree.wait(lock);
+		return _free[--_numFree];
+	}
+
+#ifdef STREAMPRINTF_URING
+	void Reap(bool wait)
+	{
+		_uring.Reap(wait, [this](unsigned index, int result) { Complete(index, result); });
+	}
+
+	// A write of buffer 'index' has completed; a short one is continued.
+	void Complete(unsigned index, int result)
+	{
+		Slot& slot = _slots[index];
+		if (result > 0 && slot.done + result < slot.len)
+		{
+			slot.done += result;
+			slot.offset += result;
+			if (_uring.Write(_fd, index, _buffers + index * _bufferSize + slot.done,
+							 slot.len - slot.done, slot.offset))
+				return;
+			result = -errno;
+		}
+		if (result == 0 && slot.done < slot.len)
+			result = -EIO;
+		if (result < 0)
+			Fail(-result);
+		_free[_numFree++] = index;
+	}
+#endif
+
+	void WorkerLoop()
+	{
+		std::unique_lock<std::mutex> lock(_mutex);
+		for (;;)
+		{
+			while (_numJobs == 0 && !_stop)
+				_workReady.wait(lock);
+			if (_numJobs == 0)
+				return;
+
+			int index = _jobs[_firstJob];
+			_firstJob = (_firstJob + 1) % _numBuffers;
+			--_numJobs;
+			lock.unlock();
+
+			Slot& slot = _slots[index];
+			const char* p = _buffers + index * _bufferSize;
+			while (slot.done < slot.len)
+			{
+				ssize_t n = pwrite(_fd, p + slot.done, slot.len - slot.done, slot.offset + slot.done);
+				if (n < 0 && errno == EINTR)
+					continue;
+				if (n <= 0)
+				{
+					Fail(n < 0 ? errno : EIO);
+					break;
+				}
+				slot.done += n;
+			}
+
+			lock.lock();
+			_free[_numFree++] = index;
+			_bufferFree.notify_one();
+		}
+	}
+
+	void Fail(int error)
+	{
+		int none = 0;
+		_error.compare_exchange_strong(none, error);
+	}
+
+	int _fd;
+	size_t _bufferSize;
+	int _numBuffers;
+	char* _buffers;			// _numBuffers buffers of _bufferSize bytes
+	Slot* _slots;
+	int* _free;				// the buffers that aren't in use
+	int _numFree;
+	int _current;			// the buffer being filled, or -1
+	size_t _len;			// how much of it is filled
+	off_t _offset;			// where in the file the next write goes
+	bool _usingUring;
+
+#ifdef STREAMPRINTF_URING
+	PrintfUring _uring;
+#endif
+
+	// the pwrite() threads, and the buffers waiting for them
+	std::thread* _workers;
+	int _numWorkers;
+	int* _jobs;
+	int _numJobs;
+	int _firstJob;
+	std::mutex _mutex;
+	std::condition_variable _workReady;
+	std::condition_variable _bufferFree;
+	bool _stop;
+
+	std::atomic<int> _error;
+};
+
+#endif // URINGPRINTF_H